@@ -29,37 +29,164 @@ SPR1 and SPR0 - Sets the SPI speed, 00 is fastest (4MHz) 11 is slowest (250KHz)
 */
 #include "Si4735.h"
 #define READ_DELAY 10
+
+//Background operations run by poll()
+#define OP_POWER_UP	1
+#define OP_TUNE	2
+#define OP_SEEK	3
+#define OP_RDS	4
+#define OP_SCAN	5
+
+//States of the poll() state machine
+#define STATE_IDLE	0	//No operation in progress
+#define STATE_WAIT_CTS	1	//Command sent, waiting for CTS
+#define STATE_WAIT_STC	2	//Waiting for the seek/tune to complete
+#define STATE_WAIT_ACK	3	//TUNE_STATUS (INTACK) sent, waiting for its response
+#define STATE_SETTLE	4	//Scan: letting the signal settle after STC
+#define STATE_WAIT_RSQ	5	//Scan: RSQ_STATUS sent, waiting for its response
+//Property profiles, each one ends with PROFILE_END
+const Property PROFILE_FM[] PROGMEM = {
+	{0x1502, 0xAA01},	//Enable RDS, only store good blocks and ones that have been corrected
+	{0x4001, 0x0000},	//Disable Mute
+	PROFILE_END
+};
+const Property PROFILE_AM[] PROGMEM = {
+	{0x4001, 0x0000},	//Disable Mute
+	PROFILE_END
+};
+const Property PROFILE_SW[] PROGMEM = {
+	{0x3400, 0x08FC},	//Set the lower band limit for Short Wave Radio to 2300 kHz
+	{0x3401, 0x59D8},	//Set the upper band limit for Short Wave Radio to 23000kHz
+	{0x4001, 0x0000},	//Disable Mute
+	PROFILE_END
+};
+const Property PROFILE_LW[] PROGMEM = {
+	{0x3400, 0x0099},	//Set the lower band limit for Long Wave Radio to 152 kHz
+	{0x3401, 0x0117},	//Set the upper band limit for Long Wave Radio to 279 kHz
+	{0x4001, 0x0000},	//Disable Mute
+	PROFILE_END
+};
+const Property PROFILE_NA[] PROGMEM = {
+	{0x1100, 0x0002},	//75 us deemphasis
+	PROFILE_END
+};
+const Property PROFILE_EU[] PROGMEM = {
+	{0x1100, 0x0001},	//50 us deemphasis
+	PROFILE_END
+};
+
+#if defined(USE_SI4735_PROPERTY_CACHE)
+//Values the radio gives these properties at POWER_UP, so begin() does not rewrite them
+const Property PROFILE_POWER_UP[] PROGMEM = {
+	{0x0001, 0x0000},	//GPO_IEN
+	{0x1502, 0x0000},	//FM_RDS_CONFIG
+	{0x4000, 0x003F},	//RX_VOLUME
+	{0x4001, 0x0000},	//RX_HARD_MUTE
+	PROFILE_END
+};
+#endif
+
+//The radio whose signalInterrupt() is called by the INT_PIN interrupt
+Si4735 * Si4735::_instance = 0;
+
 //This is just a constructor.
 //Default values are assigned to various private variables
 Si4735::Si4735(){
 	_mode		= FM;
 	_locale	= NA;
 	_volume	= 63;
-	_ab		= 0;
-	_year		= 0;
-	_month	= 0;
-	_day		= 0;
-	_hour		= 0;
-	_minute	= 0;	
-	_newRadioText = 0;
-	clearRDS();
+	_error	= SI4735_OK;
+	memset(&_tuned, 0, sizeof(_tuned));
+	_opState	= STATE_IDLE;
+	_opHandle	= 0;
+	_opResult	= SI4735_OK;
+	_callback	= 0;
+	_eventHandler	= 0;
+	#if defined(USE_SI4735_PROPERTY_CACHE)
+	_cacheCount	= 0;
+	_cacheHits	= 0;
+	_cacheMisses	= 0;
+	#endif
+	#if defined(USE_SI4735_BUS_STATS)
+	resetBusStats();
+	#endif
+	_batchCount	= 0;
+	_batchErrors	= 0;
+	_intPending	= false;
+	_intSources	= 0;
+	#if defined(USE_SI4735_SEEK)
+	_tunedStale	= false;
+	#endif
+	#if defined(USE_SI4735_SCAN)
+	_scanSink	= 0;
+	_scanFirst	= 0;
+	_scanLast	= 0;
+	_scanStep	= 1;
+	_scanDone	= 0;
+	_scanCancel	= false;
+	_scanList	= 0;
+	#endif
+	_rdsGroups	= 0;
+	_rdsDropped	= 0;
+	#if defined(USE_SI4735_RDS) && defined(USE_SI4735_DATE_TIME)
+	_timeReceived	= 0;
+	#endif
+	#if defined(USE_SI4735_RDS)
+	_decoder.reset(&_rds);
+	#endif
+	#if defined(USE_SI4735_RDS) && defined(USE_SI4735_STATION_CACHE)
+	_stationChecked = false;
+	#endif
+	#if defined(USE_SI4735_RDS) && defined(USE_SI4735_RDS_STATS)
+	memset(&_rdsStats, 0, sizeof(_rdsStats));
+	_tunedAt	= 0;
+	#endif
+	#if defined(USE_SI4735_RDS) && defined(USE_SI4735_AF) && defined(USE_SI4735_RSQ)
+	_networkPI	= 0;
+	_networkCount	= 0;
+	_networkRejected	= 0;
+	_followThreshold	= 0;
+	_followChecked	= 0;
+	_followWait	= 0;
+	#endif
+	#if defined(USE_SI4735_CAPTURE)
+	_captureSink	= 0;
+	_captureSources	= 0;
+	_captureStatusLast	= false;
+	_captureRepeats	= 0;
+	#endif
 }
 
 void Si4735::clearRDS(void){
-	byte i;
-	for(i=0; i<64; i++)	_disp[i]	='\0';
-	for(i=0; i<8; i++) 	_ps[i]	='\0';
-	for(i=0; i<16; i++) 	_pty[i]	='\0';
-	for(i=0; i<4; i++) 	_csign[i]='\0';		
+	#if defined(USE_SI4735_RDS) && defined(USE_SI4735_STATION_CACHE)
+	//Keep what is known about the station the radio is leaving
+	_stations.save(&_rds, _tuned.frequency);
+	_stationChecked = false;
+	#endif
+	#if defined(USE_SI4735_RDS)
+	_decoder.reset(&_rds);
+	#endif
+	#if defined(USE_SI4735_RDS) && defined(USE_SI4735_RDS_STATS)
+	_rdsStats.firstPS = 0;
+	_rdsStats.firstRadioText = 0;
+	_tunedAt = millis();
+	#endif
 }
 
 void Si4735::begin(char mode){
+	finish(startBegin(mode));
+}
+
+byte Si4735::startBegin(char mode){
+	byte length;
+	//Let any background operation complete before restarting the radio
+	while(poll());
 	_mode = mode;
 	//Start by resetting the Si4735 and configuring the comm. protocol to SPI
 	pinMode(POWER_PIN, OUTPUT);
 	pinMode(RADIO_RESET_PIN, OUTPUT);
-	pinMode(DATAIN, OUTPUT);  //Data In (GPO1) must be driven high after reset to select SPI
-	pinMode(INT_PIN, OUTPUT);  //Int_Pin (GPO2) must be driven high after reset to select SPI
+	pinMode(DATAIN, OUTPUT);  //Data In (GPO1) must be driven high after reset to select SPI or 2-wire mode
+	pinMode(INT_PIN, OUTPUT);  //Int_Pin (GPO2) must be driven high after reset to select SPI, low for 2-wire mode
 
 	//Sequence the power to the Si4735
 	digitalWrite(RADIO_RESET_PIN, LOW);  
@@ -67,7 +194,11 @@ void Si4735::begin(char mode){
 
 	//Configure the device for SPI communication
 	digitalWrite(DATAIN, HIGH);
+	#if defined(SI4735_BUS_I2C)
+	digitalWrite(INT_PIN, LOW);
+	#else
 	digitalWrite(INT_PIN, HIGH);
+	#endif
 	delay(1);
 	digitalWrite(POWER_PIN, HIGH);
 	delay(1);
@@ -75,72 +206,53 @@ void Si4735::begin(char mode){
 	delay(1);
 
 	//Now configure the I/O pins properly
-	pinMode(DATAOUT, OUTPUT);
 	pinMode(DATAIN, INPUT);
-	pinMode(SPICLOCK,OUTPUT);
 	pinMode(SS,OUTPUT); 
 	pinMode(INT_PIN, INPUT); 
 	digitalWrite(SS, HIGH);	
 
-	//Configure the SPI hardware
-	//SPIClass::begin();
-	//SPIClass::setClockDivider(SPI_CLOCK_DIV32);
-	SPCR = (1<<SPE)|(1<<MSTR);//|(1<<SPR1)|(1<<SPR0);	//Enable SPI HW, Master Mode	
+	//Configure the bus hardware
+	busBegin();
 	
 	//Send the POWER_UP command
-	switch(_mode){
-		case FM:
-			sprintf(command, "%c%c%c", 0x01, 0x50, 0x05);
-			break;
-		case AM:
-		case SW:
-		case LW:
-			sprintf(command, "%c%c%c", 0x01, 0x51, 0x05);
-			break;
-		default:
-			return;
-	}
-	sendCommand(command, 3);
-	delay(200);
+	if(_mode > LW) return 0;
+	length = cmdPowerUp(command, _mode);
+	#if defined(USE_SI4735_PROPERTY_CACHE)
+	//POWER_UP restores the default value of every property
+	clearPropertyCache();
+	for(const Property * entry = PROFILE_POWER_UP; pgm_read_word(&entry->address) != 0; entry++)
+		cacheProperty(-1, pgm_read_word(&entry->address), pgm_read_word(&entry->value));
+	#endif
+	//The crystal has to settle before CTS is reported, poll() configures the radio afterwards
+	return startOp(OP_POWER_UP, length, TIMEOUT_POWER_UP);
+}
 
+void Si4735::configure(void){
 	//Configure GPO lines to maximize stability
-	sprintf(command, "%c%c", 0x80,0x06);
-	sendCommand(command, 2);
-	delay(10);
-	sprintf(command, "%c%c", 0x81,0x04);
-	sendCommand(command, 2);
-	delay(10);
+	sendCommand(command, cmdGpio(command, CMD_GPIO_CTL, 0x06));
+	sendCommand(command, cmdGpio(command, CMD_GPIO_SET, 0x04));
 
-	//Set the volume to the current value.
-	setVolume(_volume);
-
-	//Disable Mute
-	unmute();
-
-	//Enable RDS
-	//Only store good blocks and ones that have been corrected
-	setProperty(0x1502, 0xAA01);	
-	//Only store good blocks
-	//setProperty(0x1502, 0x0001)
-	
-
-	//Set the seek band for the desired mode (AM and FM can use default values)
+	//Apply the mode's profile (RDS, mute and seek band) along with the current volume
+	beginProperties();
 	switch(_mode){
+		case FM:
+			stageProfile(PROFILE_FM);
+			break;
 		case SW:
-			//Set the lower band limit for Short Wave Radio to 2300 kHz
-			setProperty(0x3400, 0x08FC);			
-			//Set the upper band limit for Short Wave Radio to 23000kHz
-			setProperty(0x3401, 0x59D8);
+			stageProfile(PROFILE_SW);
 			break;
 		case LW:
-			//Set the lower band limit for Long Wave Radio to 152 kHz
-			setProperty(0x3400, 0x0099);			
-			//Set the upper band limit for Long Wave Radio to 279 kHz
-			setProperty(0x3401, 0x0117);							
+			stageProfile(PROFILE_LW);
 			break;
 		default:
+			stageProfile(PROFILE_AM);
 			break;
 	}	
+	stageProperty(0x4000, (word)_volume);
+	commitProperties();
+
+	//POWER_UP has reset GPO2 and GPO_IEN, hand the interrupts back to the application
+	if(_intSources && _instance == this) enableInterrupts(_intSources);
 }
 
 void Si4735::sendCommand(char * myCommand){
@@ -158,32 +270,38 @@ void Si4735::sendCommand(char * myCommand){
 		command[index++] += tempValue;
 		*myCommand++;
 	}
+	#if defined(USE_SI4735_PROPERTY_CACHE)
+	//The command may change properties behind the cache's back
+	clearPropertyCache();
+	#endif
 	//Now send the command to the radio
 	sendCommand(command, index);
 }
 
-void Si4735::tuneFrequency(word frequency){
-	//Split the desired frequency into two character for use in the
-	//set frequency command.
-	byte highByte = frequency >> 8;
-	byte lowByte = frequency & 0x00FF;
-	
-	//Depending on the current mode, set the new frequency.
-	switch(_mode){
-		case FM:
-			sprintf(command, "%c%c%c%c", 0x20, 0x00, highByte, lowByte);
-			break;
-		case AM:
-		case SW:
-		case LW:
-			sprintf(command, "%c%c%c%c", 0x40, 0x00, highByte, lowByte);
-			break;
-		default:
-			break;
+byte Si4735::tuneFrequency(word frequency){
+	byte error;
+	//Let any background operation complete, startTune() would refuse to start
+	while(poll());
+	for(byte attempt=0; attempt<=TUNE_RETRIES; attempt++){
+		error = finish(startTune(frequency));
+		//TUNE_STATUS has already been read to acknowledge STC, checking the frequency costs nothing
+		//An unreadable TUNE_STATUS (floating MISO) reads 0xFFFF and can not be checked
+		if(error != SI4735_OK || _tuned.frequency == frequency || _tuned.frequency == 0xFFFF) return error;
 	}
-	sendCommand(command, 4);
-	delay(100);	
-	clearRDS();
+	_error = SI4735_MISMATCH;
+	return _error;
+}
+
+byte Si4735::startTune(word frequency){
+	byte length;
+	byte handle;
+	if(_mode > LW) return 0;
+	//Depending on the current mode, set the new frequency.
+	length = cmdTuneFreq(command, _mode, frequency);
+	handle = startOp(OP_TUNE, length, TIMEOUT_TUNE);
+	//The station information is only cleared once the radio is really leaving the station
+	if(handle) clearRDS();
+	return handle;
 }
 #if defined(USE_SI4735_REV)
 void Si4735::getREV(char*FW,char*CMP,char*REV){
@@ -191,101 +309,92 @@ void Si4735::getREV(char*FW,char*CMP,char*REV){
 	//CMP = Component Revision and it is a 2 character array
 	//REV = Chip Revision and it is a single character
 	char response [16];
-	sprintf(command, "%c", 0x10);
+	const RevResponse * rev = (const RevResponse *)response;
 	
 	//Send the command
-	sendCommand(command, 1);
+	sendCommand(command, cmdNoArgs(command, CMD_GET_REV));
 
 	//Now read the response	
-	getResponse(response);	
+	getResponse(response, sizeof(RevResponse));	
 
-	FW[0]=response[2];
-	FW[1]=response[3];
+	FW[0]=rev->firmware[0];
+	FW[1]=rev->firmware[1];
 	FW[2]='\0';
-	CMP[0]=response[6];
-	CMP[1]=response[7];
+	CMP[0]=rev->component[0];
+	CMP[1]=rev->component[1];
 	CMP[2]='\0';
-	*REV=response[8];	
+	*REV=rev->chipRevision;	
 }
 #endif //USE_SI4735_REV
 #if defined(USE_SI4735_FREQUENCY)
 word Si4735::getFrequency(bool &valid){
 	char response [16];
-	word frequency;	
-	byte highByte;
-	byte lowByte;
+	const TuneResponse * tune = (const TuneResponse *)response;
 
-	switch(_mode){
-		case FM:			
-			//The FM_TUNE_STATUS command
-			sprintf(command, "%c%c", 0x22, 0x00);
-			break;
-		case AM:
-		case SW:
-		case LW:
-			//The AM_TUNE_STATUS command
-			sprintf(command, "%c%c", 0x42, 0x00);			
-			break;
-		default:
-			break;
-	}	
-	
-	//Send the command
-	sendCommand(command, 2);
+	//Send the FM_TUNE_STATUS or AM_TUNE_STATUS command
+	sendCommand(command, cmdTuneStatus(command, _mode, false));
 
 	//Now read the response	
-	getResponse(response);	
-
-	//Convert the bytes of the response to a frequency value	
-	highByte=(((response[2]>>7)/(-1))<<7)+(response[2]&127);
-	lowByte=(((response[3]>>7)/(-1))<<7)+(response[3]&127);
-	frequency = (highByte<<8)+lowByte;
+	getResponse(response, TUNE_FREQUENCY_LENGTH);	
 
 	//Check to see if the Si4735 is currently "busy"	
-	valid=(response[0]&1)==1;
+	valid=tune->complete();
 
-	return frequency;
+	return tune->frequency();
 }
 #endif //USE_SI4735_FREQUENCY
+void Si4735::getTuneResult(TuneResult * result){
+	*result = _tuned;
+}
 #if defined(USE_SI4735_SEEK)
 void Si4735::seekUp(void){
 	//Use the current mode selection to seek up.
-	switch(_mode){
-		case FM:
-			sprintf(command, "%c%c", 0x21, 0x0C);
-			sendCommand(command, 2);
-			break;
-		case AM:
-		case SW:
-		case LW:
-			sprintf(command, "%c%c%c%c%c%c", 0x41, 0x0C, 0x00, 0x00, 0x00, 0x00);
-			sendCommand(command, 6);
-			break;
-		default:
-			break;
-	}
-	delay(1);
+	if(_mode > LW) return;
+	//The station being left is cached under its frequency, which a previous seek may not have reported yet
+	readStaleTune();
+	sendCommand(command, cmdSeekStart(command, _mode, true, true));
 	clearRDS();
+	_tunedStale = true;
 }
 
 void Si4735::seekDown(void){
 	//Use the current mode selection to seek down.
-	switch(_mode){
-		case FM:
-			sprintf(command, "%c%c", 0x21, 0x04);
-			sendCommand(command, 2);
-			break;
-		case AM:
-		case SW:
-		case LW:
-			sprintf(command, "%c%c%c%c%c%c", 0x41, 0x04, 0x00, 0x00, 0x00, 0x00);
-			sendCommand(command, 6);
-			break;
-		default:
-			break;
-	}	
-	delay(1);
+	if(_mode > LW) return;
+	readStaleTune();
+	sendCommand(command, cmdSeekStart(command, _mode, false, true));
 	clearRDS();
+	_tunedStale = true;
+}
+
+void Si4735::readStaleTune(void){
+	char status[2];
+	char response[16];
+	const TuneResponse * tune = (const TuneResponse *)response;
+	if(!_tunedStale) return;
+	//TUNE_STATUS without INTACK, so processEvents() still sees the STC interrupt.
+	//Not in the command buffer: startOp() has its own command waiting there.
+	sendCommand(status, cmdTuneStatus(status, _mode, false));
+	getResponse(response, sizeof(TuneResponse));
+	//Until the seek completes the frequency is only where it has got to
+	if(tune->complete()) saveTune(response);
+}
+
+byte Si4735::seek(byte direction, TuneResult * result){
+	byte error;
+	while(poll());
+	error = finish(startSeek(direction));
+	if(result) *result = _tuned;
+	return error;
+}
+
+byte Si4735::startSeek(byte direction){
+	byte length;
+	byte handle;
+	if(_mode > LW) return 0;
+	length = cmdSeekStart(command, _mode, direction == SEEK_UP, true);
+	handle = startOp(OP_SEEK, length, TIMEOUT_SEEK);
+	if(handle) clearRDS();
+	return handle;
 }
 
 void Si4735::seekThresholds(byte SNR, byte RSSI){
@@ -315,193 +424,237 @@ void Si4735::seekThresholds(byte SNR, byte RSSI){
 }
 
 #endif //USE_SI4735_SEEK
-#if defined(USE_SI4735_RDS)
-bool Si4735::readRDS(void){
-	char status;
-	char response [16];	
-	bool ps_rdy=false;
- 
-	sprintf(command, "%c%c", 0x24, 0x00);
-	sendCommand(command, 2);
- 
-	//Now read the response	
-	getResponse(response);
- 
-	//response[4] = RDSA high BLOCK1
-	//response[5] = RDSA low
-	//response[6] = RDSB high BLOCK2
-	//response[7] = RDSB low
-	//response[8] = RDSC high BLOCK3
-	//response[9] = RDSC low
-	//response[10] = RDSD high BLOCK4
-	//response[11] = RDSD low
-	byte pty = ((response[6]&3) << 3) | ((response[7] >> 5)&7);
-	ptystr(pty);
-
-	byte type = (response[6]>>4) & 15;
-	bool version = bitRead(response[6], 4);
-	bool tp = bitRead(response[6], 5);	
-	int pi;
-
-	if (version == 0) {
-		pi = MAKEINT(response[4], response[5]);
-	} else {
-		pi = MAKEINT(response[8], response[9]);
-	}
-	#if defined(USE_SI4735_CALLSIGN)
-	if(pi>=21672){
- 		_csign[0]='W';
-		pi-=21672;
-	}
-	else if(pi<21672 && pi>=4096){
-		_csign[0]='K';
-		pi-=4096;
+#if defined(USE_SI4735_SCAN)
+byte Si4735::scan(word first, word last, word step, byte settle, ScanSink sink){
+	while(poll());
+	return finish(startScan(first, last, step, settle, sink));
+}
+
+byte Si4735::startScan(word first, word last, word step, byte settle, ScanSink sink){
+	byte handle;
+	if(_mode > LW || step == 0 || last < first) return 0;
+	handle = startOp(OP_SCAN, cmdTuneFreq(command, _mode, first), TIMEOUT_TUNE);
+	if(handle){
+		//The RDS information of the station being left is kept in the station cache
+		clearRDS();
+		_scanSink = sink;
+		_scanFirst = first;
+		_scanLast = last;
+		_scanStep = step;
+		_scanSettle = settle;
+		_scanDone = 0;
+		_scanCancel = false;
 	}
-	else{
-		pi=-1;
+	return handle;
+}
+
+void Si4735::cancelScan(void){
+	_scanCancel = true;
+}
+
+byte Si4735::getScanProgress(void){
+	return (unsigned long)_scanDone * 100 / ((_scanLast - _scanFirst) / _scanStep + 1);
+}
+
+byte Si4735::findStations(word first, word last, word step, byte rssi, byte snr, ScanStation * stations, byte size){
+	//First pass: the channels that pass the thresholds are kept by listStation()
+	_scanList = stations;
+	_scanListSize = size;
+	_scanListCount = 0;
+	_scanRssi = rssi;
+	_scanSnr = snr;
+	scan(first, last, step, SCAN_SETTLE, 0);
+	_scanList = 0;
+	#if defined(USE_SI4735_RDS)
+	//Second pass: only the stations that are left are given the time to send a group
+	if(_mode == FM){
+		char response[16];
+		for(byte i=0; i<_scanListCount; i++){
+			if(finish(startOp(OP_TUNE, cmdTuneFreq(command, _mode, stations[i].frequency), TIMEOUT_TUNE)) != SI4735_OK) continue;
+			stations[i].pi = readPI(response, SCAN_PI_TIMEOUT);
+		}
 	}
-	if(pi>=0){
-		_csign[1]=char(pi/676+65);//char(pi/676);
-		_csign[2]=char((pi - 676*int(pi/676))/26+65);//char((pi-676*(_csign[1]))/26+65);
-		_csign[3]=char(((pi - 676*int(pi/676))%26)+65);//char((pi-676*(_csign[1]))%26+65);
-		//_csign[1]+=65;
-		_csign[4]='\0';		
+	#endif
+	return _scanListCount;
+}
+
+void Si4735::listStation(const ScanRecord * record){
+	ScanStation * station;
+	byte weakest = 0;
+	if(record->rssi < _scanRssi || record->snr < _scanSnr || _scanListSize == 0) return;
+	if(_scanListCount == _scanListSize){
+		//Make room at the end by dropping the weakest station, if it is weaker than this one
+		for(byte i=1; i<_scanListCount; i++){
+			if(_scanList[i].rssi < _scanList[weakest].rssi) weakest = i;
+		}
+		if(_scanList[weakest].rssi >= record->rssi) return;
+		memmove(&_scanList[weakest], &_scanList[weakest+1], (_scanListCount - weakest - 1) * sizeof(ScanStation));
+		_scanListCount--;
 	}
-	else{
-		_csign[0]='U';
-		_csign[1]='N';
-		_csign[2]='K';
-		_csign[3]='N';
-		_csign[4]='\0';
+	station = &_scanList[_scanListCount++];
+	station->frequency = record->frequency;
+	station->rssi = record->rssi;
+	station->snr = record->snr;
+	station->pi = 0;
+}
+#endif //USE_SI4735_SCAN
+#if defined(USE_SI4735_RDS)
+bool Si4735::readRDS(void){
+	drainRDS(0);
+	return _rds.psReady;
+}
+
+byte Si4735::drainRDS(byte * dropped){
+	while(poll());
+	finish(startRdsRead());
+	if(dropped) *dropped = _rdsDropped;
+	return _rdsGroups;
+}
+
+byte Si4735::startRdsRead(void){
+	byte handle;
+	//INTACK clears the RDS interrupt, the first FM_RDS_STATUS returns the oldest group in the FIFO
+	handle = startOp(OP_RDS, cmdRdsStatus(command, true, false), TIMEOUT_COMMAND);
+	if(handle){
+		_rds.psReady = false;
+		_rdsGroups = 0;
+		_rdsDropped = 0;
 	}
-	#endif //USE_SI4735_CALLSIGN
+	return handle;
+}
 
-	// Groups 0A & 0B
-	// Basic tuning and switching information only
-	if (type == 0) {
-	#if defined(USE_SI4735_PTY)
-		bool ta = bitRead(response[7], 4);
-		bool ms = bitRead(response[7], 3);
-		byte addr = response[7] & 3;
-		bool diInfo = bitRead(response[7], 2);
- 
-		// Groups 0A & 0B: to extract PS segment we need blocks 1 and 3
-		if (addr >= 0 && addr<= 3) {
-			if (response[10] != '\0')
-				_ps[addr*2] = response[10];
-			if (response[11] != '\0')
-				_ps[addr*2+1] = response[11];
-			ps_rdy=(addr==3);
-		}	
-		printable_str(_ps, 8);
-	#endif //USE_SI4735_PTY
-	}
-	// Groups 2A & 2B
-	// Radio Text
-	else if (type == 2) {
-		#if defined(USE_SI4735_RADIOTEXT)
-		// Get their address
-		int addressRT = response[7] & 15; // Get rightmost 4 bits
-		bool ab = bitRead(response[7], 4);
- 		bool cr = 0; //indicates that a carriage return was received
-		byte len = 64;
-		if (version == 0) {
-			if (addressRT >= 0 && addressRT <= 15) {
-				if (response[8] != 0x0D )
-					_disp[addressRT*4] = response[8];
-				else{
-					len=addressRT*4;
-					cr=1;
-				}
-				if (response[9] != 0x0D)
-					_disp[addressRT*4+1] = response[9];
-				else{
-					len=addressRT*4+1;
-					cr=1;
-				}
-				if (response[10] != 0x0D)
-					_disp[addressRT*4+2] = response[10]; 
-				else{
-					len=addressRT*4+2;
-					cr=1;
-				}
-				if (response[11] != 0x0D)
-					_disp[addressRT*4+3] = response[11];
-				else{
-					len=addressRT*4+3;
-					cr=1;
-				}
-			}
-		} else {
-			if (addressRT >= 0 && addressRT <= 7) {
-				if (response[10] != '\0')
-					_disp[addressRT*2] = response[10];
-				if (response[11] != '\0')
-					_disp[addressRT*2+1] = response[11];
-			}
-		}
-		if(cr){
-			for (byte i=len; i<64; i++) _disp[i] = ' ';
-		}
-		if (ab != _ab) {			
-			for (byte i=0; i<64; i++) _disp[i] = ' ';
-			_disp[64] = '\0';			
-			_newRadioText=1;
-		}
-		else{
-			_newRadioText=0;
-		}
-		_ab = ab;
-		printable_str(_disp, 64);
-		#endif //USE_SI4735_RADIOTEXT
-	}
-	// Group 4A	Clock-time and Date
-	//Note the time is localized but the date is the UTC date
-	//Setting offset to 0 will make the time referenced to UTC
-	else if (type == 4 && version == 0){	
-		#if defined(USE_SI4735_DATE_TIME)
-		unsigned long MJD = (response[7]&3<<15 | u_int(response[8])<<7 | (response[9]>>1)&127)&0x01FFFF;
-		u_int Y=(MJD-15078.2)/365.25;
-		u_int M=(MJD-14956.1-u_int(Y*365.25))/30.6001;		
-		byte K;
-		if(M==14||M==15)
-			K=1;
-		else
-			K=0;
-		_year=(Y+K)%100;
-		_month=M-1-K*12;
-		_day=MJD-14956-u_int(Y*365.25)-u_int(M*30.6001);		
-		
-		char sign=(((response[11]>>5)&1)/(-1));
-		if(sign==0)sign=1; //Make sign a bipolar variable
-		char offset=sign*(response[11]&31);
-
-		_hour=((response[9]&1)<<4) | ((response[10]>>4)&15);
-		_minute=((response[10]&15)<<2 | (response[11]>>6)&3);			
-		_hour= (_hour + (offset/2) + 24)%24;		
-		_minute=(_minute + (offset)%2*30 + 60)%60;
-		#endif //USE_SI4735_DATE_TIME
-	}	
-	delay(40);
-	//This is a simple way to indicate when the ps data has been fully refreshed.
-	return ps_rdy; 
+void Si4735::decodeRDS(char * response){
+	const RdsResponse * rds = (const RdsResponse *)response;
+	RDSGroup group;
+
+	for(byte i=0; i<4; i++) group.block[i] = rds->block(i);
+	group.errors = rds->errors;
+	#if defined(USE_SI4735_CAPTURE)
+	//The error levels follow the blocks in the response
+	if(_captureSources & CAPTURE_GROUPS) capture(CAPTURE_GROUP, rds->blocks, 9);
+	#endif
+	byte sequence = _rds.rtSequence;
+	#if defined(USE_SI4735_RDS_STATS)
+	word pi = _rds.pi;
+	//Block B holds the group type, the type of a group whose block B was not corrected is unknown
+	if(rds->errorLevel(1) < 3) _rdsStats.groups[group.block[1] >> 11]++;
+	for(byte i=0; i<4; i++) _rdsStats.errorLevels[i][rds->errorLevel(i)]++;
+	#endif
+	#if defined(USE_SI4735_DATE_TIME)
+	byte timeSequence = _rds.time.sequence;
+	_decoder.decode(&_rds, &group);
+	if(_rds.time.sequence != timeSequence) _timeReceived = millis();
+	#else
+	_decoder.decode(&_rds, &group);
+	#endif
+	if(_rds.rtSequence != sequence) dispatchEvent(EVENT_RADIOTEXT);
+	#if defined(USE_SI4735_RDS_STATS)
+	if(pi && _rds.pi != pi) _rdsStats.piChanges++;
+	//At least 1 ms, 0 means not received yet
+	if(!_rdsStats.firstPS && _rds.psStable) _rdsStats.firstPS = (millis() - _tunedAt) | 1;
+	if(!_rdsStats.firstRadioText && _rds.rtSequence != sequence) _rdsStats.firstRadioText = (millis() - _tunedAt) | 1;
+	#endif
+	#if defined(USE_SI4735_STATION_CACHE)
+	//The first PI code tells whether this is a station the radio has been tuned to before
+	if(!_stationChecked && _rds.pi){
+		_stationChecked = true;
+		_stations.restore(&_rds, _tuned.frequency);
+	}
+	#endif
 }
 
  
+#if defined(USE_SI4735_PTY)
+void Si4735::getProgramType(char * programType){
+	//The PI code is 0 until the first group has been decoded
+	if(_rds.pi == 0) programType[0] = '\0';
+	else ptystr(_rds.pty, programType);
+}
+#endif
+
+const char * Si4735::programService(void){
+	return _rds.programService;
+}
+
+const char * Si4735::radioText(void){
+	return _rds.radioText;
+}
+
+const char * Si4735::callSign(void){
+	return _rds.callSign;
+}
+
+byte Si4735::programType(void){
+	return _rds.pty;
+}
+
+word Si4735::programIdentification(void){
+	return _rds.pi;
+}
+
+#if defined(USE_SI4735_PTYN)
+const char * Si4735::programTypeName(void){
+	return _rds.ptyName;
+}
+#endif
+
+#if defined(USE_SI4735_RTPLUS)
+bool Si4735::getTitle(char * title, byte size){
+	return RDSDecoder::tagText(&_rds, &_rds.title, title, size);
+}
+
+bool Si4735::getArtist(char * artist, byte size){
+	return RDSDecoder::tagText(&_rds, &_rds.artist, artist, size);
+}
+#endif
+
+#if defined(USE_SI4735_EON)
+byte Si4735::getOtherNetworks(RDSOtherNetwork * networks, byte size){
+	byte count = (_rds.otherCount < size) ? _rds.otherCount : size;
+	memcpy(networks, _rds.otherNetworks, count * sizeof(RDSOtherNetwork));
+	return count;
+}
+#endif
+
+#if defined(USE_SI4735_SLOW_LABELS)
+byte Si4735::extendedCountryCode(void){
+	return _rds.ecc;
+}
+
+byte Si4735::languageCode(void){
+	return _rds.language;
+}
+#endif
+
+byte Si4735::rdsChanges(void){
+	byte changes = _rds.changed;
+	_rds.changed = 0;
+	return changes;
+}
+
 void Si4735::getRDS(Station * tunedStation) {
-	strcpy(tunedStation->programService, _ps);
-	strcpy(tunedStation->radioText, _disp);	
-	strcpy(tunedStation->programType, _pty);
-	strcpy(tunedStation->callSign, _csign);
-	tunedStation->newRadioText=_newRadioText;		
+	strcpy(tunedStation->programService, _rds.programService);
+	strcpy(tunedStation->radioText, _rds.radioText);	
+	#if defined(USE_SI4735_PTY)
+	getProgramType(tunedStation->programType);
+	#else
+	tunedStation->programType[0] = '\0';
+	#endif
+	strcpy(tunedStation->callSign, _rds.callSign);
+	tunedStation->newRadioText=_rds.newRadioText;
+	tunedStation->psStable=_rds.psStable;
+	tunedStation->rtStable=_rds.rtStable;		
 }
 #if defined(USE_SI4735_DATE_TIME)
 void Si4735::getTime(Today * date){
-	date->year=_year;
-	date->month=_month;
-	date->day=_day;
-	date->hour=_hour;
-	date->minute=_minute;
+	if(_rds.time.valid) RDSDecoder::localTime(&_rds.time, date);
+	else memset(date, 0, sizeof(Today));
+}
+
+bool Si4735::getClockTime(RDSTime * time, unsigned long * age){
+	*time = _rds.time;
+	if(age) *age = millis() - _timeReceived;
+	return time->valid;
 }
 #endif //USE_SI4735_DATE_TIME
 #endif //USE_SI4735_RDS
@@ -509,36 +662,22 @@ void Si4735::getTime(Today * date){
 void Si4735::getRSQ(Metrics * RSQ){
 	//This function gets the Received Signal Quality Information
 	char response [16];
+	const RsqResponse * rsq = (const RsqResponse *)response;
 	
-	switch(_mode){
-		case FM:			
-			//The FM_RSQ_STATUS command
-			sprintf(command, "%c%c", 0x23, 0x00);
-			break;
-		case AM:
-		case SW:
-		case LW:
-			//The AM_RSQ_STATUS command
-			sprintf(command, "%c%c", 0x43, 0x00);			
-			break;
-		default:
-			break;
-	}	
-	
-	//Send the command
-	sendCommand(command, 2);
+	//Send the FM_RSQ_STATUS or AM_RSQ_STATUS command (INTACK clears the RSQ interrupt)
+	sendCommand(command, cmdRsqStatus(command, _mode, true));
 
 	//Now read the response	
-	getResponse(response);	
+	getResponse(response, sizeof(RsqResponse));	
 
 	//Pull the response data into their respecive fields
-	RSQ->RSSI=response[4];
-	RSQ->SNR=response[5];
+	RSQ->RSSI=rsq->rssi;
+	RSQ->SNR=rsq->snr;
 
 	if(_mode==FM){
-		RSQ->STBLEND=response[3]&63;
-		RSQ->MULT=response[6];
-		RSQ->FREQOFF=response[7];
+		RSQ->STBLEND=rsq->stereoBlend();
+		RSQ->MULT=rsq->multipath;
+		RSQ->FREQOFF=rsq->frequencyOffset;
 	}
 	else{
 		RSQ->STBLEND=0;
@@ -547,6 +686,98 @@ void Si4735::getRSQ(Metrics * RSQ){
 	}
 }
 #endif
+#if defined(USE_SI4735_RDS) && defined(USE_SI4735_AF)
+byte Si4735::getAlternativeFrequencies(word * frequencies, byte size){
+	byte count = (_rds.afCount < size) ? _rds.afCount : size;
+	for(byte i=0; i<count; i++) frequencies[i] = RDSDecoder::afFrequency(_rds.afCodes[i]);
+	return count;
+}
+#endif
+#if defined(USE_SI4735_RDS) && defined(USE_SI4735_AF) && defined(USE_SI4735_RSQ)
+void Si4735::enableFollowing(byte threshold){
+	_followThreshold = threshold;
+	_followChecked = millis();
+	_followWait = 0;
+}
+
+bool Si4735::checkFollowing(void){
+	Metrics rsq;
+	word original = _tuned.frequency;
+	word frequency;
+	byte current;
+
+	if(!_followThreshold || _mode != FM || _opState != STATE_IDLE) return false;
+	if(millis() - _followChecked < _followWait) return false;
+	_followChecked = millis();
+	_followWait = AF_CHECK_INTERVAL;
+
+	updateNetwork();
+	getRSQ(&rsq);
+	if(rsq.RSSI >= _followThreshold || !_rds.pi || _networkPI != _rds.pi) return false;
+	current = rsq.RSSI;
+
+	for(byte i=0; i<_networkCount; i++){
+		frequency = RDSDecoder::afFrequency(_networkCodes[i]);
+		if(frequency == original || bitRead(_networkRejected, i)) continue;
+		if(tuneAlternative(frequency) != SI4735_OK) continue;
+		//The RSSI is known as soon as the tune completes, the PI code takes another group
+		getRSQ(&rsq);
+		if(rsq.RSSI < current + AF_MARGIN) continue;
+		if(checkPI(_rds.pi)) return true;
+		_networkRejected |= 1 << i;
+	}
+
+	//Nothing better: go back and leave the network alone for a while
+	if(_tuned.frequency != original) tuneAlternative(original);
+	_followWait = AF_RETRY_INTERVAL;
+	return false;
+}
+
+void Si4735::updateNetwork(void){
+	bool known;
+	if(!_rds.pi || !_rds.afCount) return;
+	if(_networkPI != _rds.pi){
+		_networkPI = _rds.pi;
+		_networkCount = 0;
+		_networkRejected = 0;
+	}
+	for(byte i=0; i<_rds.afCount && _networkCount < AF_LIST_SIZE; i++){
+		known = false;
+		for(byte j=0; j<_networkCount; j++)
+			if(_networkCodes[j] == _rds.afCodes[i]) known = true;
+		if(!known) _networkCodes[_networkCount++] = _rds.afCodes[i];
+	}
+}
+
+byte Si4735::tuneAlternative(word frequency){
+	while(poll());
+	return finish(startOp(OP_TUNE, cmdTuneFreq(command, _mode, frequency), TIMEOUT_TUNE));
+}
+
+bool Si4735::checkPI(word pi){
+	char response[16];
+	if(readPI(response, AF_PI_TIMEOUT) != pi) return false;
+	decodeRDS(response);
+	return true;
+}
+#endif
+#if defined(USE_SI4735_RDS)
+word Si4735::readPI(char * response, word timeout){
+	const RdsResponse * rds = (const RdsResponse *)response;
+	unsigned long start = millis();
+
+	//Empty the FIFO so that no group received before the tune is taken for the new transmitter
+	sendCommand(command, cmdRdsStatus(command, true, true));
+	do{
+		//A group takes 88 ms: check at a fraction of that rather than keeping the bus busy
+		delay(20);
+		sendCommand(command, cmdRdsStatus(command, true, false));
+		getResponse(response, sizeof(RdsResponse));
+		if(rds->fifoUsed && rds->errorLevel(0) < 3) return rds->block(0);
+	}while(millis() - start < timeout);
+	return 0;
+}
+#endif
 #if defined(USE_SI4735_VOLUME)
 byte Si4735::volumeUp(void){
 	//If we're not at the maximum volume yet, increase the volume
@@ -593,30 +824,258 @@ void Si4735::unmute(void){
 }
 #endif //USE_SI4735_MUTE
 
+byte Si4735::getLastError(void){
+	return _error;
+}
+
+void Si4735::enableInterrupts(byte sources){
+	//Hand GPO2 back to the INT function, begin() drives it as a plain output
+	sendCommand(command, cmdGpio(command, CMD_GPIO_CTL, 0x02));
+	if((sources & INT_RDS) && _mode == FM){
+		//Interrupt as soon as a single group is in the FIFO
+		setProperty(0x1500, 0x0001);
+		setProperty(0x1501, 0x0001);
+	}
+	if(sources & INT_RSQ){
+		//Interrupt when RSSI or SNR cross the thresholds set with setProperty()
+		setProperty((_mode == FM) ? 0x1200 : 0x3200, 0x000F);
+	}
+	setProperty(0x0001, sources);
+	_intSources = sources;
+
+	_instance = this;
+	attachInterrupt(INT_NUMBER, isr, FALLING);
+}
+
+void Si4735::disableInterrupts(void){
+	detachInterrupt(INT_NUMBER);
+	setProperty(0x0001, 0x0000);
+	_intPending = false;
+	_intSources = 0;
+}
+
+void Si4735::signalInterrupt(void){
+	_intPending = true;
+}
+
+void Si4735::onEvent(EventCallback handler){
+	_eventHandler = handler;
+}
+
+byte Si4735::processEvents(void){
+	char response[16];
+	byte status;
+	byte events = 0;
+
+	if(!_intPending) return 0;
+	_intPending = false;
+
+	//A pending start*() operation consumes its own STC through poll()
+	if(_opState != STATE_IDLE) poll();
+
+	status = getStatus();
+	if((status & STATUS_STCINT) && _opState == STATE_IDLE){
+		//Fetch the station found and clear the STC interrupt (INTACK)
+		sendCommand(command, cmdTuneStatus(command, _mode, true));
+		getResponse(response, sizeof(TuneResponse));
+		saveTune(response);
+		dispatchEvent(EVENT_TUNE_COMPLETE);
+		events++;
+	}
+	//The RDS and RSQ interrupts are cleared when the application reads them (readRDS(), getRSQ())
+	if(status & STATUS_RDSINT){
+		dispatchEvent(EVENT_RDS_READY);
+		events++;
+	}
+	if(status & STATUS_RSQINT){
+		dispatchEvent(EVENT_RSQ);
+		events++;
+	}
+	if(status & STATUS_ERR){
+		dispatchEvent(EVENT_ERROR);
+		events++;
+	}
+	return events;
+}
+
+bool Si4735::poll(void){
+	char response[16];
+	char ack[2];
+	byte status;
+
+	if(_opState == STATE_IDLE) return false;
+
+	status = getStatus();
+	#if defined(USE_SI4735_SCAN)
+	if(status == STATUS_FLOATING && _opState != STATE_SETTLE){
+	#else
+	if(status == STATUS_FLOATING){
+	#endif
+		//Without the GPO1 diode each step is given its worst case time, as the blocking commands are,
+		//then taken as done. The RDS FIFO can not be read at all.
+		if(_op == OP_RDS){
+			finishOp(SI4735_ERROR);
+			return false;
+		}
+		if(millis() - _opStart < ((_opState == STATE_WAIT_STC || _op == OP_POWER_UP) ? _opTimeout : TIMEOUT_COMMAND)) return true;
+		status = STATUS_CTS | STATUS_STCINT;
+		_opStart = millis();
+	}
+	switch(_opState){
+		case STATE_WAIT_CTS:
+			if(!(status & STATUS_CTS)) break;
+			if(status & STATUS_ERR){
+				finishOp(SI4735_ERROR);
+				return false;
+			}
+			if(_op == OP_TUNE || _op == OP_SEEK || _op == OP_SCAN){
+				_opState = STATE_WAIT_STC;
+				break;
+			}
+			#if defined(USE_SI4735_RDS)
+			if(_op == OP_RDS){
+				const RdsResponse * rds = (const RdsResponse *)response;
+				getResponse(response, sizeof(RdsResponse));
+				#if defined(USE_SI4735_RDS_STATS)
+				//The interrupt bits are only cleared by the first FM_RDS_STATUS (INTACK) of the read
+				if(_rdsGroups == 0 && rds->syncLost()) _rdsStats.syncLosses++;
+				if(rds->groupLost()) _rdsStats.overflows++;
+				#endif
+				//RDSFIFOUSED counts the group in this response, there is nothing to decode when it is 0
+				if(rds->fifoUsed == 0){
+					_opState = STATE_IDLE;
+					finishOp(SI4735_OK);
+					return false;
+				}
+				decodeRDS(response);
+				_rdsGroups++;
+				if(rds->groupLost()) _rdsDropped++;
+				if(rds->fifoUsed > 1 && _rdsGroups < 255){
+					//Fetch the next group, the interrupt has already been acknowledged
+					sendCommand(ack, cmdRdsStatus(ack, false, false), 0);
+					_opStart = millis();
+					break;
+				}
+			}
+			#endif
+			//The radio is free again: the completion work may use the blocking calls
+			_opState = STATE_IDLE;
+			if(_op == OP_POWER_UP){
+				configure();
+			}
+			finishOp(SI4735_OK);
+			return false;
+		case STATE_WAIT_STC:
+			if(!(status & STATUS_STCINT)) break;
+			//Fetch the station found with TUNE_STATUS, clearing the STC interrupt (INTACK)
+			sendCommand(ack, cmdTuneStatus(ack, _mode, true), 0);
+			_opState = STATE_WAIT_ACK;
+			break;
+		case STATE_WAIT_ACK:
+			if(!(status & STATUS_CTS)) break;
+			_opState = STATE_IDLE;
+			getResponse(response, sizeof(TuneResponse));
+			saveTune(response);
+			#if defined(USE_SI4735_SCAN)
+			if(_op == OP_SCAN && _scanCancel){
+				finishOp(SI4735_CANCELLED);
+				return false;
+			}
+			if(_op == OP_SCAN && !(status & STATUS_ERR)){
+				_opState = STATE_SETTLE;
+				_opStart = millis();
+				return true;
+			}
+			#endif
+			finishOp((status & STATUS_ERR) ? SI4735_ERROR : SI4735_OK);
+			return false;
+		#if defined(USE_SI4735_SCAN)
+		case STATE_SETTLE:
+			if(millis() - _opStart < _scanSettle) return true;
+			sendCommand(response, cmdRsqStatus(response, _mode, false), 0);
+			_opState = STATE_WAIT_RSQ;
+			_opStart = millis();
+			break;
+		case STATE_WAIT_RSQ:{
+			const RsqResponse * rsq = (const RsqResponse *)response;
+			ScanRecord record;
+			bool done;
+			if(!(status & STATUS_CTS)) break;
+			if(status & STATUS_ERR){
+				finishOp(SI4735_ERROR);
+				return false;
+			}
+			getResponse(response, sizeof(RsqResponse));
+			record.frequency = _tuned.frequency;
+			record.rssi = rsq->rssi;
+			record.snr = rsq->snr;
+			record.multipath = (_mode == FM) ? rsq->multipath : 0;
+			record.offset = (_mode == FM) ? rsq->frequencyOffset : 0;
+			record.valid = rsq->valid();
+			_scanDone++;
+			done = _scanCancel || _scanDone > (_scanLast - _scanFirst) / _scanStep;
+			if(!done){
+				//The next channel is tuned while the sink handles this one, a cancel takes effect once it is tuned
+				sendCommand(response, cmdTuneFreq(response, _mode, _scanFirst + _scanDone * _scanStep), 0);
+				_opState = STATE_WAIT_CTS;
+			}
+			if(_scanSink) _scanSink(&record);
+			else if(_scanList) listStation(&record);
+			if(done){
+				finishOp(_scanCancel ? SI4735_CANCELLED : SI4735_OK);
+				return false;
+			}
+			_opStart = millis();
+			break;
+		}
+		#endif
+		default:
+			break;
+	}
+
+	if(millis() - _opStart >= _opTimeout){
+		finishOp(SI4735_TIMEOUT);
+		return false;
+	}
+	return true;
+}
+
+byte Si4735::getOpStatus(byte handle){
+	if(handle == 0) return SI4735_ERROR;
+	if(handle == _opHandle && _opState != STATE_IDLE) return SI4735_BUSY;
+	//Only the most recent result is kept, an older handle may have failed as well as succeeded
+	return (handle == _opHandle) ? _opResult : SI4735_EXPIRED;
+}
+
+byte Si4735::finish(byte handle){
+	while(poll());
+	return getOpStatus(handle);
+}
+
+void Si4735::onComplete(CompletionCallback callback){
+	_callback = callback;
+}
+
 char Si4735::getStatus(void){
 	char response;
-	digitalWrite(SS, LOW);
-	delay(1);
-	spiTransfer(0xA0);  //Set up to read a single byte
-	delay(1);
-	response = spiTransfer(0x00);  //Get the commands response
-	digitalWrite(SS, HIGH);
+	busRead(&response, 1);
 	return response;
 }
 
 void Si4735::getResponse(char * response){
-	digitalWrite(SS, LOW);
-	delay(1);
-	spiTransfer(0xE0);  //Set up to read the long response
-	delay(1);
-	for(int i=0; i<16; i++)*response++ = spiTransfer(0x00);  //Assign the response to the string.
-	digitalWrite(SS, HIGH);
+	busRead(response, 16);
+}
+
+void Si4735::getResponse(char * response, byte length){
+	busRead(response, (length > 16) ? 16 : length);
 }
 
 void Si4735::end(void){
-	sprintf(command, "%c", 0x11);
-	sendCommand(command, 1);
-	delay(1);
+	sendCommand(command, cmdNoArgs(command, CMD_POWER_DOWN));
+	#if defined(USE_SI4735_PROPERTY_CACHE)
+	//The properties return to their defaults at the next POWER_UP
+	clearPropertyCache();
+	#endif
 }
 #if defined(USE_SI4735_LOCALE)
 void Si4735::setLocale(byte locale){
@@ -624,14 +1083,18 @@ void Si4735::setLocale(byte locale){
 	//Set the deemphasis to match the locale
 	switch(_locale){
 		case NA:			
-			setProperty(0x1100, 0x0002);		
+			applyProfile(PROFILE_NA);		
 			break;
 		case EU:
-			setProperty(0x1100, 0x0001);
+			applyProfile(PROFILE_EU);
 			break;
 		default:
 			break;
 	}
+	#if defined(USE_SI4735_RDS)
+	//The program type names depend on the locale
+	_rds.changed |= RDS_CHANGED_PTY;
+	#endif
 }
 
 byte Si4735::getLocale(void){
@@ -651,18 +1114,170 @@ char Si4735::getMode(void){
 #endif //USE_SI4735_MODE
 
 void Si4735::setProperty(word address, word value){	
-	sprintf(command, "%c%c%c%c%c%c", 0x12, 0x00, (address>>8)&255, address&255, (value>>8)&255, value&255);
-	sendCommand(command, 6);
-	delay(1);
+	#if defined(USE_SI4735_PROPERTY_CACHE)
+	int slot = findProperty(address);
+	//The radio already holds this value, skip the write
+	if(slot >= 0 && _cacheValue[slot] == value){
+		_cacheHits++;
+		_error = SI4735_OK;
+		return;
+	}
+	_cacheMisses++;
+	#endif
+	if(sendCommand(command, cmdSetProperty(command, address, value)) != SI4735_OK)
+		return;
+	#if defined(USE_SI4735_PROPERTY_CACHE)
+	cacheProperty(slot, address, value);
+	#endif
 }
 
 word Si4735::getProperty(word address){	
 	char response [16];	
-	sprintf(command, "%c%c%c%c", 0x13, 0x00, (address>>8)&255, address&255);
-	sendCommand(command, 4);
-	getResponse(response);
-	return response[2]<<8 | response[3];
+	const PropertyResponse * property = (const PropertyResponse *)response;
+	word value;
+	#if defined(USE_SI4735_PROPERTY_CACHE)
+	int slot = findProperty(address);
+	if(slot >= 0){
+		_cacheHits++;
+		return _cacheValue[slot];
+	}
+	_cacheMisses++;
+	#endif
+	if(sendCommand(command, cmdGetProperty(command, address)) != SI4735_OK)
+		return 0;
+	getResponse(response, sizeof(PropertyResponse));
+	value = property->value();
+	#if defined(USE_SI4735_PROPERTY_CACHE)
+	cacheProperty(slot, address, value);
+	#endif
+	return value;
+}
+
+void Si4735::beginProperties(void){
+	_batchCount = 0;
+	_batchErrors = 0;
+}
+
+bool Si4735::stageProperty(word address, word value){
+	//A later write to the same property replaces the staged one
+	for(byte i=0; i<_batchCount; i++){
+		if(_batch[i].address == address){
+			_batch[i].value = value;
+			return true;
+		}
+	}
+	if(_batchCount >= PROPERTY_BATCH_SIZE) return false;
+	_batch[_batchCount].address = address;
+	_batch[_batchCount++].value = value;
+	return true;
+}
+
+bool Si4735::stageProfile(const Property * profile){
+	bool staged = true;
+	for(; pgm_read_word(&profile->address) != 0; profile++)
+		staged &= stageProperty(pgm_read_word(&profile->address), pgm_read_word(&profile->value));
+	return staged;
+}
+
+byte Si4735::commitProperties(void){
+	byte failed = 0;
+	_batchErrors = 0;
+	//Each write only waits for CTS, and writes the radio already holds are skipped by setProperty()
+	for(byte i=0; i<_batchCount; i++){
+		setProperty(_batch[i].address, _batch[i].value);
+		if(_error != SI4735_OK){
+			_batchErrors |= (1 << i);
+			failed++;
+		}
+	}
+	_batchCount = 0;
+	return failed;
+}
+
+byte Si4735::getBatchErrors(void){
+	return _batchErrors;
+}
+
+byte Si4735::applyProfile(const Property * profile){
+	byte failed = 0;
+	for(; pgm_read_word(&profile->address) != 0; profile++){
+		setProperty(pgm_read_word(&profile->address), pgm_read_word(&profile->value));
+		if(_error != SI4735_OK) failed++;
+	}
+	return failed;
+}
+
+#if defined(USE_SI4735_PROPERTY_CACHE)
+void Si4735::getCacheStats(CacheStats * stats){
+	stats->hits = _cacheHits;
+	stats->misses = _cacheMisses;
+	stats->entries = _cacheCount;
+}
+
+void Si4735::resetCacheStats(void){
+	_cacheHits = 0;
+	_cacheMisses = 0;
+}
+
+void Si4735::clearPropertyCache(void){
+	_cacheCount = 0;
+}
+#endif //USE_SI4735_PROPERTY_CACHE
+
+#if defined(USE_SI4735_RDS) && defined(USE_SI4735_STATION_CACHE)
+void Si4735::getStationCacheStats(CacheStats * stats){
+	_stations.getStats(stats);
+}
+
+void Si4735::clearStationCache(void){
+	_stations.clear();
+}
+#endif
+
+#if defined(USE_SI4735_RDS) && defined(USE_SI4735_RDS_STATS)
+void Si4735::getRDSStats(RDSStats * stats){
+	*stats = _rdsStats;
+}
+
+void Si4735::resetRDSStats(void){
+	word firstPS = _rdsStats.firstPS;
+	word firstRadioText = _rdsStats.firstRadioText;
+	memset(&_rdsStats, 0, sizeof(_rdsStats));
+	_rdsStats.firstPS = firstPS;
+	_rdsStats.firstRadioText = firstRadioText;
+}
+#endif
+
+#if defined(USE_SI4735_BUS_STATS)
+void Si4735::getBusStats(BusStats * stats){
+	*stats = _bus;
+}
+
+void Si4735::resetBusStats(void){
+	_bus.transactions = 0;
+	_bus.bytesWritten = 0;
+	_bus.bytesRead = 0;
 }
+#endif //USE_SI4735_BUS_STATS
+
+#if defined(USE_SI4735_CAPTURE)
+void Si4735::startCapture(CaptureSink sink, byte sources){
+	byte header[CAPTURE_HEADER_LENGTH];
+	stopCapture();
+	_captureSink = sink;
+	_captureSources = sources;
+	_captureTime = micros();
+	_captureStatusLast = false;
+	_captureRepeats = 0;
+	sink(header, captureHeader(header, sources));
+}
+
+void Si4735::stopCapture(void){
+	if(_captureSink) flushCapture();
+	_captureSink = 0;
+	_captureSources = 0;
+}
+#endif //USE_SI4735_CAPTURE
 
 /*******************************************
 *
@@ -670,104 +1285,214 @@ word Si4735::getProperty(word address){
 *
 *******************************************/
 
-char Si4735::spiTransfer(char value){
-	SPDR = value;                    // Start the transmission
-	while (!(SPSR & (1<<SPIF)))     // Wait for the end of the transmission
-	{
-	};
-	return SPDR;                    // return the received byte
+byte Si4735::sendCommand(char * command, int length, word timeout){
+  char frame[8];
+  //Blocking commands wait for any background operation to finish first.
+  //The command is copied since the completion work may reuse the command buffer.
+  if(timeout != 0 && _opState != STATE_IDLE){
+    memcpy(frame, command, length);
+    command = frame;
+    while(poll());
+  }
+  busWrite(command, length);
+  //Hold on to the CPU only until the radio is ready for the next command
+  if(timeout == 0) return SI4735_OK;
+  return waitForStatus(STATUS_CTS, timeout);
+}
+
+#if defined(USE_SI4735_CAPTURE)
+void Si4735::capture(byte type, const void * data, byte length){
+	byte record[CAPTURE_RECORD_MAX];
+	unsigned long now = micros();
+	//A status read that returns what the one before did is only counted
+	if(type == CAPTURE_RESPONSE && length == 1 && _captureStatusLast
+			&& *(const byte *)data == _captureStatus && _captureRepeats < 0xFFFF){
+		_captureRepeats++;
+		_captureRepeatTime = now;
+		return;
+	}
+	flushCapture();
+	_captureSink(record, captureRecord(record, type, now - _captureTime, data, length));
+	_captureTime = now;
+	_captureStatusLast = (type == CAPTURE_RESPONSE && length == 1);
+	_captureStatus = *(const byte *)data;
 }
 
-void Si4735::sendCommand(char * command, int length){
-  digitalWrite(SS, LOW);
-  delay(1);
-  spiTransfer(0x48);  //Contrl byte to write an SPI command (now send 8 bytes)
-  for(int i=0; i<length; i++)spiTransfer(command[i]);
-  for(int i=length; i<8; i++)spiTransfer(0x00);  //Fill the rest of the command arguments with 0
-  digitalWrite(SS, HIGH);  //End the sequence
+void Si4735::flushCapture(void){
+	byte record[CAPTURE_RECORD_MAX];
+	byte count[2];
+	if(!_captureRepeats) return;
+	count[0] = _captureRepeats & 0xFF;
+	count[1] = _captureRepeats >> 8;
+	_captureSink(record, captureRecord(record, CAPTURE_REPEAT, _captureRepeatTime - _captureTime, count, count[1] ? 2 : 1));
+	_captureTime = _captureRepeatTime;
+	_captureRepeats = 0;
+}
+#endif
+
+byte Si4735::waitForStatus(byte mask, word timeout){
+	unsigned long start = millis();
+	byte status;
+	do{
+		status = getStatus();
+		//A floating MISO would look like CTS and ERR
+		if(status == STATUS_FLOATING) continue;
+		if((status & mask) == mask){
+			_error = (status & STATUS_ERR) ? SI4735_ERROR : SI4735_OK;
+			return _error;
+		}
+	}while(millis() - start < timeout);
+	//Without a status the timeout is the worst case for the command, it has completed by now
+	_error = (status == STATUS_FLOATING) ? SI4735_OK : SI4735_TIMEOUT;
+	return _error;
+}
+
+void Si4735::isr(void){
+	if(_instance) _instance->signalInterrupt();
+}
+
+void Si4735::dispatchEvent(byte event){
+	if(_eventHandler) _eventHandler(event);
+}
+
+byte Si4735::startOp(byte op, int length, word timeout){
+	//The radio only runs one command at a time
+	if(_opState != STATE_IDLE) return 0;
+	#if defined(USE_SI4735_SEEK)
+	//The operation may leave the station, or read RDS for it: either needs its frequency
+	readStaleTune();
+	#endif
+	if(++_opHandle == 0) _opHandle = 1;
+	_op = op;
+	_opState = STATE_WAIT_CTS;
+	_opStart = millis();
+	_opTimeout = timeout;
+	sendCommand(command, length, 0);
+	return _opHandle;
+}
+
+void Si4735::finishOp(byte result){
+	_opState = STATE_IDLE;
+	_opResult = result;
+	_error = result;
+	if(_callback) _callback(_opHandle, result);
+}
+
+void Si4735::saveTune(const char * response){
+	const TuneResponse * tune = (const TuneResponse *)response;
+	_tuned.frequency = tune->frequency();
+	_tuned.bandLimit = tune->bandLimit();
+	_tuned.valid = tune->valid();
+	_tuned.rssi = tune->rssi;
+	_tuned.snr = tune->snr;
+	_tuned.multipath = (_mode == FM) ? tune->multipath : 0;
+	#if defined(USE_SI4735_SEEK)
+	_tunedStale = false;
+	#endif
+	#if defined(USE_SI4735_RDS) && defined(USE_SI4735_RDS_STATS)
+	_tunedAt = millis();
+	#endif
 }
 #if defined(USE_SI4735_PTY)
-void Si4735::ptystr(byte pty){	
+//Program Type names: the RBDS names (0 - 31) followed by the RDS names that RBDS does not use
+const char PTY_NAMES[][17] PROGMEM = {
+	"      None      ",
+	"      News      ",
+	"  Information   ",
+	"     Sports     ",
+	"      Talk      ",
+	"      Rock      ",
+	"  Classic Rock  ",
+	"   Adult Hits   ",
+	"   Soft Rock    ",
+	"     Top 40     ",
+	"    Country     ",
+	"     Oldies     ",
+	"      Soft      ",
+	"   Nostalgia    ",
+	"      Jazz      ",
+	"   Classical    ",
+	"Rhythm and Blues",
+	"   Soft R & B   ",
+	"Foreign Language",
+	"Religious Music ",
+	" Religious Talk ",
+	"  Personality   ",
+	"     Public     ",
+	"    College     ",
+	" Reserved  -24- ",
+	" Reserved  -25- ",
+	" Reserved  -26- ",
+	" Reserved  -27- ",
+	" Reserved  -28- ",
+	"     Weather    ",
+	" Emergency Test ",
+	"  !!!ALERT!!!   ",
+	"Current Affairs ",
+	"   Education    ",
+	"     Drama      ",
+	"    Cultures    ",
+	"    Science     ",
+	" Varied Speech  ",
+	" Easy Listening ",
+	" Light Classics ",
+	"Serious Classics",
+	"  Other Music   ",
+	"    Finance     ",
+	"Children's Progs",
+	" Social Affairs ",
+	"    Phone In    ",
+	"Travel & Touring",
+	"Leisure & Hobby ",
+	" National Music ",
+	"   Folk Music   ",
+	"  Documentary   ",
+	" LOCALE UNKN0WN ",
+	"    PTY ERROR   "};
+
+#define PTY_LOCALE_UNKNOWN	51
+#define PTY_ERROR	52
+
+//Index in PTY_NAMES of each RDS (Europe) program type
+const byte PTY_EU[32] PROGMEM = {0, 1, 32, 2, 
+		3, 33, 34, 35,
+		36, 37, 9, 5, 
+		38, 39, 40, 41,
+		29, 42, 43, 44, 
+		20, 45, 46, 47,
+		14, 10, 48, 11, 
+		49, 50, 30, 31 };
+
+void Si4735::ptystr(byte pty, char * name){	
 	// Translate the Program Type bits to the RBDS 16-character fields	
-	if(pty>=0 && pty<32){
-		char* pty_LUT[51] = {	
-			"      None      ",
-			"      News      ",
-			"  Information   ",
-			"     Sports     ",
-			"      Talk      ",
-			"      Rock      ",
-			"  Classic Rock  ",
-			"   Adult Hits   ",
-			"   Soft Rock    ",
-			"     Top 40     ",
-			"    Country     ",
-			"     Oldies     ",
-			"      Soft      ",
-			"   Nostalgia    ",
-			"      Jazz      ",
-			"   Classical    ",
-			"Rhythm and Blues",
-			"   Soft R & B   ",
-			"Foreign Language",
-			"Religious Music ",
-			" Religious Talk ",
-			"  Personality   ",
-			"     Public     ",
-			"    College     ",
-			" Reserved  -24- ",
-			" Reserved  -25- ",
-			" Reserved  -26- ",
-			" Reserved  -27- ",
-			" Reserved  -28- ",
-			"     Weather    ",
-			" Emergency Test ",
-			"  !!!ALERT!!!   ",
-			"Current Affairs ",
-			"   Education    ",
-			"     Drama      ",
-			"    Cultures    ",
-			"    Science     ",
-			" Varied Speech  ",
-			" Easy Listening ",
-			" Light Classics ",
-			"Serious Classics",
-			"  Other Music   ",
-			"    Finance     ",
-			"Children's Progs",
-			" Social Affairs ",
-			"    Phone In    ",
-			"Travel & Touring",
-			"Leisure & Hobby ",
-			" National Music ",
-			"   Folk Music   ",
-			"  Documentary   "};
-		if(_locale==NA){		
-			strcpy(_pty, pty_LUT[pty]);
-		}
-		else if(_locale==EU){
-			byte LUT[32] = {0, 1, 32, 2, 
-					3, 33, 34, 35,
-					36, 37, 9, 5, 
-					38, 39, 40, 41,
-					29, 42, 43, 44, 
-					20, 45, 46, 47,
-					14, 10, 48, 11, 
-					49, 50, 30, 31 };
-			strcpy(_pty, pty_LUT[LUT[pty]]);
-		}
-		else{
-			strcpy(_pty, " LOCALE UNKN0WN ");
-		}
+	byte index;
+	if(pty<32){
+		if(_locale==NA) index = pty;
+		else if(_locale==EU) index = pgm_read_byte(&PTY_EU[pty]);
+		else index = PTY_LOCALE_UNKNOWN;
 	}
 	else{
-		strcpy(_pty, "    PTY ERROR   ");
+		index = PTY_ERROR;
 	}	
+	strcpy_P(name, PTY_NAMES[index]);
 }
 #endif //USE_SI4735_PTY
 
-void Si4735::printable_str(char * str, int length){
-	for(int i=0;i<length;i++){
-		if( (str[i]!=0 && str[i]<32) || str[i]>126 ) str[i]=' ';	
+#if defined(USE_SI4735_PROPERTY_CACHE)
+int Si4735::findProperty(word address){
+	for(byte i=0; i<_cacheCount; i++){
+		if(_cacheAddress[i] == address) return i;
+	}
+	return -1;
+}
+
+void Si4735::cacheProperty(int slot, word address, word value){
+	if(slot < 0){
+		//Properties that do not fit are simply not cached
+		if(_cacheCount >= PROPERTY_CACHE_SIZE) return;
+		slot = _cacheCount++;
+		_cacheAddress[slot] = address;
 	}
+	_cacheValue[slot] = value;
 }
+#endif //USE_SI4735_PROPERTY_CACHE
@@ -18,42 +18,122 @@
 #define USE_SI4735_REV
 #define USE_SI4735_FREQUENCY
 #define USE_SI4735_SEEK
+#define USE_SI4735_SCAN
 
 #define USE_SI4735_RDS
 #define USE_SI4735_CALLSIGN
 #define USE_SI4735_PTY
 #define USE_SI4735_RADIOTEXT
 #define USE_SI4735_DATE_TIME
+#define USE_SI4735_AF
+//Optional RDS group decoders
+#define USE_SI4735_RTPLUS		//RadioText+ title and artist tags (open data application announced in group 3A)
+#define USE_SI4735_PTYN			//Program type name (group 10A)
+#define USE_SI4735_EON			//Program service names of other networks (group 14A)
+#define USE_SI4735_SLOW_LABELS	//Extended country code and language (group 1A)
 
 #define USE_SI4735_RSQ
 #define USE_SI4735_VOLUME
 #define USE_SI4735_MUTE
 #define USE_SI4735_LOCALE
 #define USE_SI4735_MODE
+#define USE_SI4735_PROPERTY_CACHE
+#define USE_SI4735_STATION_CACHE
+#define USE_SI4735_STATION_INDEX
+//Diagnostics are left out unless asked for: they add RAM to every Si4735 and code to every bus transfer.
+//Uncomment them, or define them on the compiler command line (-DUSE_SI4735_CAPTURE) as the host benchmark does.
+//#define USE_SI4735_BUS_STATS
+//#define USE_SI4735_RDS_STATS
+//#define USE_SI4735_CAPTURE
 
+//Number of properties remembered by the property cache (4 bytes of RAM each)
+#define PROPERTY_CACHE_SIZE	12
+//Number of property writes that can be staged between beginProperties() and commitProperties() (at most 8)
+#define PROPERTY_BATCH_SIZE	8
+//Confidence an RDS text segment needs before it is shown. Each reception of the segment adds 3 when its
+//blocks had no errors, 2 when 1-2 bits were corrected and 1 when 3-5 bits were corrected.
+#define RDS_CONFIDENCE	3
+//Number of stations whose RDS information is kept for when the radio returns to them (78 bytes of RAM each)
+#define STATION_CACHE_SIZE	2
+//Number of alternative frequencies kept for the tuned network (at most 16, 1 byte of RAM each, twice)
+#define AF_LIST_SIZE	12
+//Station following: time between two signal checks and between two searches that found nothing (in ms),
+//and the RSSI (dBuV) an alternative frequency must have above the tuned one to be worth the switch
+#define AF_CHECK_INTERVAL	1000
+#define AF_RETRY_INTERVAL	10000
+#define AF_MARGIN	6
+//Time allowed for an alternative frequency to send its PI code (in ms)
+#define AF_PI_TIMEOUT	250
+//Number of other networks whose program service name is kept (11 bytes of RAM each)
+#define EON_SIZE	4
+//findStations(): time (in ms) the signal is given to settle before it is measured, and time allowed
+//for a station that passed the signal thresholds to send its PI code
+#define SCAN_SETTLE	0
+#define SCAN_PI_TIMEOUT	300
+//Number of stations a StationIndex can hold (10 bytes of RAM, or EEPROM, each)
+#define STATION_INDEX_SIZE	24
+//Times tuneFrequency() tunes again when the radio reports another frequency than the one asked for
+#define TUNE_RETRIES	2
 
-#if defined(ARDUINO) && ARDUINO >= 100
+//Select the bus used to talk to the Si4735 (only one of these may be defined).
+//The bus is fixed at compile time so the byte transfers are inlined into the callers.
+//	SI4735_BUS_AVR_SPI - Drives the AVR SPI registers directly (Uno, Mega and similar boards).
+//	SI4735_BUS_SPI - Uses the Arduino SPI library, for boards with other SPI hardware.
+//	SI4735_BUS_I2C - Uses the Wire library, the radio is strapped for 2-wire mode at reset.
+//Host builds (SI4735_HOST) always talk to the simulated radio.
+#if !defined(SI4735_BUS_AVR_SPI) && !defined(SI4735_BUS_SPI) && !defined(SI4735_BUS_I2C)
+#define SI4735_BUS_AVR_SPI
+#endif
+
+#if defined(SI4735_HOST)
+  #include "Si4735_Host.h"
+#elif defined(ARDUINO) && ARDUINO >= 100
   #include "Arduino.h"  
 #else
   #include "WProgram.h"  
 #endif
 
-//#include "SPI.h"
+#if defined(SI4735_HOST)
+	#undef SI4735_BUS_AVR_SPI
+	#undef SI4735_BUS_SPI
+	#undef SI4735_BUS_I2C
+#elif defined(SI4735_BUS_SPI)
+	#include "SPI.h"
+#elif defined(SI4735_BUS_I2C)
+	#include "Wire.h"
+#endif
 #include "string.h"
 
 //Assign the radio pin numbers
-#define POWER_PIN	8
-#define	RADIO_RESET_PIN	9
-#define INT_PIN	2
+//Any of the pin numbers may be overridden from the compiler command line (e.g. -DPOWER_PIN=5)
+#if !defined(POWER_PIN)
+	#define POWER_PIN	8
+#endif
+#if !defined(RADIO_RESET_PIN)
+	#define	RADIO_RESET_PIN	9
+#endif
+#if !defined(INT_PIN)
+	#define INT_PIN	2
+#endif
+#if !defined(INT_NUMBER) && defined(digitalPinToInterrupt)
+	#define INT_NUMBER	digitalPinToInterrupt(INT_PIN)	//External interrupt attached to INT_PIN
+#elif !defined(INT_NUMBER)
+	#define INT_NUMBER	0	//Cores without digitalPinToInterrupt(): pin 2 on the Uno
+#endif
 
 //Define the SPI Pin Numbers
-#if defined(MEGA)
+#if defined(SI4735_BUS_SPI) && !defined(DATAIN)
+	//Use the pins of the board the SPI library was built for
+	#define DATAOUT MOSI
+	#define DATAIN  MISO
+	#define SPICLOCK  SCK
+#elif defined(MEGA) && !defined(DATAIN)
 	//DEFINE THE MEGA PINS
 	#define DATAOUT 51		//MOSI
 	#define DATAIN  50		//MISO 
 	#define SPICLOCK  52		//sck
 	#define SS 53	  			//ss
-#else
+#elif !defined(DATAIN)
 	//DEFINE THE UNO PINS
 	#define DATAOUT 11		//MOSI
 	#define DATAIN  12		//MISO 
@@ -61,6 +141,9 @@
 	#define SS 10	  		//ss
 #endif
 
+//In 2-wire mode the radio answers at 0x63 when SEN (driven by SS) is high
+#define SI4735_I2C_ADDRESS	0x63
+
 //List of possible modes for the Si4735 Radio
 #define AM	0
 #define FM	1
@@ -74,10 +157,56 @@
 #define ON	true
 #define OFF	false
 
+//Bits of the status byte returned by getStatus()
+#define STATUS_CTS	0x80	//Clear To Send the next command
+#define STATUS_ERR	0x40	//The last command was rejected
+#define STATUS_RSQINT	0x08	//Received Signal Quality interrupt
+#define STATUS_RDSINT	0x04	//RDS interrupt
+#define STATUS_STCINT	0x01	//Seek/Tune Complete interrupt
+//What a status read returns when nothing drives MISO (no GPO1 diode). Bits 5:4 are reserved, the radio never sends it.
+#define STATUS_FLOATING	0xFF
+
+//Result codes reported by getLastError()
+#define SI4735_OK	0
+#define SI4735_TIMEOUT	1	//CTS or STC was not seen before the timeout expired
+#define SI4735_ERROR	2	//The radio reported an error for the command
+#define SI4735_BUSY	3	//The operation has not completed yet (see getOpStatus())
+#define SI4735_CANCELLED	4	//The scan was stopped by cancelScan()
+#define SI4735_MISMATCH	5	//tuneFrequency(): the radio kept reporting another frequency than the one asked for
+#define SI4735_EXPIRED	6	//getOpStatus(): a newer operation has started, the result of this one is no longer kept
+
+//Worst case completion times (in ms) for the CTS/STC polling.
+//These are upper bounds only; each command returns as soon as the radio reports that it is ready.
+#define TIMEOUT_POWER_UP	500
+#define TIMEOUT_COMMAND	10
+#define TIMEOUT_TUNE	250
+#define TIMEOUT_SEEK	15000	//A full sweep of the FM or AM band
+
+//Interrupt sources for enableInterrupts() (bits of the GPO_IEN property)
+#define INT_STC	0x01	//Seek/Tune complete
+#define INT_RDS	0x04	//RDS FIFO has data
+#define INT_RSQ	0x08	//Signal quality crossed a threshold
+#define INT_ERR	0x40	//Command error
+
+//Events passed to the EventCallback by processEvents()
+#define EVENT_TUNE_COMPLETE	1
+#define EVENT_RDS_READY	2
+#define EVENT_RSQ	3
+#define EVENT_ERROR	4
+//Sent by readRDS() (or poll()) when a RadioText message is complete, not through processEvents()
+#define EVENT_RADIOTEXT	5
+
+//Seek directions used by startSeek()
+#define SEEK_DOWN	0
+#define SEEK_UP	1
+
 #define MAKEINT(msb, lsb) (((msb) << 8) | (lsb))
 typedef unsigned int u_int;
 //typedef unsigned char byte;
 
+#include "Si4735_Commands.h"
+#include "Si4735_Capture.h"
+
 typedef struct Today {
 	byte year; //The 2-digit year
 	byte month;
@@ -106,10 +235,92 @@ typedef struct Station {
 	char programService[9];
 	char radioText[65];
 	bool newRadioText;
+	bool psStable;			//Every segment of the program service name has reached RDS_CONFIDENCE
+	bool rtStable;			//The RadioText message being received is complete
 	//Metrics signalQuality;
 	//int frequency
 };
 
+//Station the radio landed on, read from the TUNE_STATUS that acknowledged the end of a tune or seek
+typedef struct TuneResult {
+	word frequency;
+	bool bandLimit;			//BLTF: the seek reached the band limit, or wrapped round to where it started, without finding a station
+	bool valid;				//The channel passes the seek thresholds
+	byte rssi;				//dBuV
+	byte snr;				//dB
+	byte multipath;			//FM only
+} TuneResult;
+
+//Called by poll() when an operation started with one of the start*() methods completes.
+//result is one of SI4735_OK, SI4735_TIMEOUT or SI4735_ERROR.
+typedef void (*CompletionCallback)(byte handle, byte result);
+
+//Called by processEvents() for each event latched from the INT pin.
+typedef void (*EventCallback)(byte event);
+
+//Signal measured on one channel by scan()
+typedef struct ScanRecord {
+	word frequency;
+	byte rssi;				//dBuV
+	byte snr;				//dB
+	byte multipath;			//FM only
+	int8_t offset;			//FM only: frequency offset (kHz)
+	bool valid;				//The channel passes the seek thresholds (see seekThresholds())
+} ScanRecord;
+
+//Called by scan() with each channel as soon as it has been measured.
+typedef void (*ScanSink)(const ScanRecord * record);
+
+//Station found by findStations()
+typedef struct ScanStation {
+	word frequency;
+	byte rssi;
+	byte snr;
+	word pi;				//RDS program identification, 0 if none was received
+} ScanStation;
+
+typedef struct Property {
+	word address;
+	word value;
+} Property;
+
+//Marks the end of a property profile
+#define PROFILE_END	{0x0000, 0x0000}
+
+//Property profiles stored in program memory, used by begin() and setLocale()
+extern const Property PROFILE_FM[];		//FM: RDS enabled, unmuted
+extern const Property PROFILE_AM[];		//AM: unmuted
+extern const Property PROFILE_SW[];		//SW: 2300 - 23000 kHz seek band, unmuted
+extern const Property PROFILE_LW[];		//LW: 152 - 279 kHz seek band, unmuted
+extern const Property PROFILE_NA[];		//North America: 75 us deemphasis
+extern const Property PROFILE_EU[];		//Europe: 50 us deemphasis
+
+typedef struct CacheStats {
+	word hits;		//Property reads served from RAM and writes skipped because nothing changed
+	word misses;	//Property reads and writes that went to the radio
+	byte entries;	//Properties currently held by the cache
+} CacheStats;
+
+typedef struct BusStats {
+	unsigned long transactions;	//Commands written plus status and response reads
+	unsigned long bytesWritten;	//Bytes sent to the radio, including the SPI control bytes
+	unsigned long bytesRead;	//Bytes received from the radio
+} BusStats;
+
+//RDS reception counters. The counters wrap at 65535, about 1.5 hours of groups of a single type.
+typedef struct RDSStats {
+	word groups[32];			//Groups received per group type code (see RDS_GROUP()), block B must be correctable
+	word errorLevels[4][4];		//Blocks received per block (A - D) and error level (0 = no errors ... 3 = uncorrectable)
+	word overflows;				//FIFO overruns reported by the radio, each one lost at least one group
+	word syncLosses;			//Times the radio lost RDS synchronization
+	word piChanges;				//Times the PI code changed without a tune (interference or a corrupted block A)
+	word firstPS;				//Time (in ms) from the last tune to a stable program service name, 0 until then
+	word firstRadioText;		//Time (in ms) from the last tune to the first complete RadioText, 0 until then
+} RDSStats;
+
+#include "Si4735_RDS.h"
+#include "Si4735_Stations.h"
+
 class Si4735// : public SPIClass
 {
 	public:
@@ -129,6 +340,91 @@ class Si4735// : public SPIClass
 		*	mode - The desired radio mode. Use AM(0), FM(1), SW(2) or LW(3).
 		*/
 		void begin(char mode);
+
+		/*
+		* Description:
+		*	Non-blocking version of begin(). The power up sequence and the configuration of the radio
+		*	are completed by poll().
+		* Returns:
+		*	A handle for getOpStatus(), or 0 if the mode is invalid or another operation is in progress.
+		*/
+		byte startBegin(char mode);
+
+		/*
+		* Description:
+		*	Advances the operation started by one of the start*() methods. Each call reads the status byte
+		*	once and moves on (send -> wait CTS -> wait STC -> fetch response) without blocking.
+		*	Call this from loop() while other work is being done.
+		* Returns:
+		*	true while an operation is still in progress.
+		*/
+		bool poll(void);
+
+		/*
+		* Description:
+		*	Gets the state of an operation started by one of the start*() methods.
+		*	Only the result of the most recent operation is kept, onComplete() is told every result.
+		* Returns:
+		*	SI4735_BUSY while the operation is in progress, otherwise its result.
+		*	SI4735_EXPIRED once another operation has started, SI4735_ERROR for the handle 0.
+		*/
+		byte getOpStatus(byte handle);
+
+		/*
+		* Description:
+		*	Blocks until the operation has completed.
+		* Returns:
+		*	The result of the operation.
+		*/
+		byte finish(byte handle);
+
+		/*
+		* Description:
+		*	Registers a function that poll() calls whenever an operation completes. Use 0 to remove it.
+		*/
+		void onComplete(CompletionCallback callback);
+
+		/*
+		* Description:
+		*	Enables the radio's interrupt sources and attaches an interrupt handler to INT_PIN.
+		*	The handler only latches the interrupt; the events are dispatched by processEvents().
+		*	The sources stay enabled when begin() powers the radio up again, until disableInterrupts().
+		* Parameters:
+		*	sources - Any combination of INT_STC, INT_RDS, INT_RSQ and INT_ERR.
+		*/
+		void enableInterrupts(byte sources);
+
+		/*
+		* Description:
+		*	Disables all interrupt sources and detaches the INT_PIN interrupt handler.
+		*/
+		void disableInterrupts(void);
+
+		/*
+		* Description:
+		*	Latches an interrupt from the radio. This is what the INT_PIN interrupt handler calls;
+		*	it can also be called from another interrupt (e.g. a pin change interrupt) or periodically
+		*	if INT_PIN is not wired to an interrupt capable pin.
+		*/
+		void signalInterrupt(void);
+
+		/*
+		* Description:
+		*	Registers the function that processEvents() calls for each event. Use 0 to remove it.
+		*/
+		void onEvent(EventCallback handler);
+
+		/*
+		* Description:
+		*	Dispatches the events latched since the last call. Call this from loop().
+		*	EVENT_TUNE_COMPLETE is sent once the tune/seek has been acknowledged, so getTuneResult()
+		*	reports the station found. EVENT_RDS_READY and EVENT_RSQ are sent once per interrupt: the
+		*	radio pulses INT when the source is raised and not again until it has been acknowledged,
+		*	so read the data with readRDS() and getRSQ() when the event arrives.
+		* Returns:
+		*	The number of events dispatched.
+		*/
+		byte processEvents(void);
 		
 		/*
 		* Description: 
@@ -140,6 +436,15 @@ class Si4735// : public SPIClass
 		*/
 		void sendCommand(char * myCommand);
 
+		/*
+		* Description:
+		*	Reports the result of the last command sent to the radio.
+		* Returns:
+		*	SI4735_OK, SI4735_TIMEOUT if the radio did not report CTS (or STC) in time,
+		*	or SI4735_ERROR if the radio set the ERR bit.
+		*/
+		byte getLastError(void);
+
 		/*
 		* Description: 
 		*	Acquires certain revision parameters from the Si4735 chip
@@ -156,11 +461,25 @@ class Si4735// : public SPIClass
 		* Description: 
 		*	Used to to tune the radio to a desired frequency. The library uses the mode indicated in the
 		* 	begin() function to determine how to set the frequency.
+		*	Waits for STC and checks the frequency reported by TUNE_STATUS; the tune is only sent again
+		*	(at most TUNE_RETRIES times) if the radio landed somewhere else.
 		* Parameters:
 		*	frequency - The frequency to tune to, in kHz (or in 10kHz if using FM mode).
+		* Returns:
+		*	SI4735_OK, SI4735_TIMEOUT, SI4735_ERROR or SI4735_MISMATCH.
 		*/
 		#if defined(USE_SI4735_FREQUENCY)
-		void tuneFrequency(word frequency);
+		byte tuneFrequency(word frequency);
+		#endif
+
+		/*
+		* Description:
+		*	Non-blocking version of tuneFrequency(). The tune is completed by poll().
+		* Returns:
+		*	A handle for getOpStatus(), or 0 if another operation is in progress.
+		*/
+		#if defined(USE_SI4735_FREQUENCY)
+		byte startTune(word frequency);
 		#endif
 
 		/*
@@ -171,10 +490,19 @@ class Si4735// : public SPIClass
 		word getFrequency(bool &valid);
 		#endif
 
+		/*
+		* Description:
+		*	Gets the station the last tune or seek landed on. It is kept from the TUNE_STATUS read that
+		*	acknowledged STC, so it takes no bus transaction. It is up to date once the operation has
+		*	completed (getOpStatus(), onComplete() or EVENT_TUNE_COMPLETE).
+		*/
+		void getTuneResult(TuneResult * result);
+
 		/*
 		* Description:
 		*	Commands the radio to seek up to the next valid channel. If the top of the band is reached, the seek
-		*	will continue from the bottom of the band.
+		*	will continue from the bottom of the band. The seek runs on its own: with interrupts enabled,
+		*	EVENT_TUNE_COMPLETE tells when getTuneResult() reports the station that was found.
 		*/
 		#if defined(USE_SI4735_SEEK)
 		void seekUp(void);
@@ -188,6 +516,31 @@ class Si4735// : public SPIClass
 		#if defined(USE_SI4735_SEEK)
 		void seekDown(void);
 		#endif
+
+		/*
+		* Description:
+		*	Starts a seek in the given direction (SEEK_UP or SEEK_DOWN), wrapping at the band limits.
+		*	The seek is completed by poll(); getTuneResult() reports the station that was found.
+		* Returns:
+		*	A handle for getOpStatus(), or 0 if another operation is in progress.
+		*/
+		#if defined(USE_SI4735_SEEK)
+		byte startSeek(byte direction);
+		#endif
+
+		/*
+		* Description:
+		*	Seeks in the given direction (SEEK_UP or SEEK_DOWN), wrapping at the band limits, and waits
+		*	until the radio has landed.
+		* Parameters:
+		*	result - Receives the station that was found (see getTuneResult()), 0 if it is not needed.
+		* Returns:
+		*	SI4735_OK, SI4735_TIMEOUT or SI4735_ERROR. A seek that found no station is SI4735_OK with
+		*	result->bandLimit set.
+		*/
+		#if defined(USE_SI4735_SEEK)
+		byte seek(byte direction, TuneResult * result = 0);
+		#endif
 		
 		/*
 		* Description:
@@ -203,15 +556,186 @@ class Si4735// : public SPIClass
 		void seekThresholds(byte SNR, byte RSSI);
 		#endif
 
+		/*
+		* Description:
+		*	Measures the signal of every channel from first to last. Each channel is tuned, the signal
+		*	is read as soon as the radio reports STC and settle ms have passed, and the record is handed
+		*	to the sink before the next channel is tuned. The radio is left on the last channel measured.
+		* Parameters:
+		*	first, last - The channels to measure, in kHz (or in 10kHz if using FM mode).
+		*	step - The channel spacing, in the same units.
+		*	settle - Time (in ms) to let the signal settle after STC, 0 to read it straight away.
+		*	sink - Receives the records. It may call cancelScan(), but no function that talks to the radio.
+		* Returns:
+		*	SI4735_OK, SI4735_CANCELLED, SI4735_TIMEOUT or SI4735_ERROR.
+		*/
+		#if defined(USE_SI4735_SCAN)
+		byte scan(word first, word last, word step, byte settle, ScanSink sink);
+		#endif
+
+		/*
+		* Description:
+		*	Non-blocking version of scan(). The channels are measured by poll().
+		* Returns:
+		*	A handle for getOpStatus(), or 0 if another operation is in progress or the range is empty.
+		*/
+		#if defined(USE_SI4735_SCAN)
+		byte startScan(word first, word last, word step, byte settle, ScanSink sink);
+		#endif
+
+		/*
+		* Description:
+		*	Stops the scan. The channel being tuned is not measured, the scan completes with SI4735_CANCELLED
+		*	once it is tuned (one channel past the last record).
+		*/
+		#if defined(USE_SI4735_SCAN)
+		void cancelScan(void);
+		#endif
+
+		/*
+		* Description:
+		*	Gets the progress of the scan in progress, or of the last one.
+		* Returns:
+		*	The channels measured, in percent of the channels to measure.
+		*/
+		#if defined(USE_SI4735_SCAN)
+		byte getScanProgress(void);
+		#endif
+
+		/*
+		* Description:
+		*	Finds the stations between first and last in two passes. The first pass measures every channel
+		*	like scan() and rejects those below the RSSI or SNR threshold after SCAN_SETTLE ms. In FM, each
+		*	channel that is left is tuned again and its PI code is read from the first group whose block A
+		*	could be corrected, waiting at most SCAN_PI_TIMEOUT ms for it. The radio is left on the last
+		*	channel tuned and the RDS information is cleared.
+		* Parameters:
+		*	rssi, snr - The signal a channel needs to be kept (dBuV, dB).
+		*	stations - Receives the stations, sorted by frequency. If there are more than size,
+		*		the weakest are left out.
+		* Returns:
+		*	The number of stations found.
+		*/
+		#if defined(USE_SI4735_SCAN)
+		byte findStations(word first, word last, word step, byte rssi, byte snr, ScanStation * stations, byte size);
+		#endif
+
 		/*
 		*  Description:
 		*	Collects the RDS information. 
 		*	This function needs to be actively called in order to see sensible information
+		*	Every group waiting in the radio's RDS FIFO is decoded, see drainRDS().
+		* Returns:
+		*	True if a complete program service name was received.
 		*/
 		#if defined(USE_SI4735_RDS)
 		bool readRDS(void);
 		#endif
 
+		/*
+		*  Description:
+		*	Reads and decodes every group waiting in the radio's RDS FIFO.
+		*	The FIFO holds about two seconds of groups, call this at least that often to avoid losing any.
+		* Parameters:
+		*	dropped - If not 0, receives the number of FIFO overruns reported by the radio. 
+		*		Each overrun lost at least one group.
+		* Returns:
+		*	The number of groups decoded.
+		*/
+		#if defined(USE_SI4735_RDS)
+		byte drainRDS(byte * dropped);
+		#endif
+
+		/*
+		*  Description:
+		*	Non-blocking version of drainRDS(). The RDS groups are fetched and decoded by poll().
+		* Returns:
+		*	A handle for getOpStatus(), or 0 if another operation is in progress.
+		*/
+		#if defined(USE_SI4735_RDS)
+		byte startRdsRead(void);
+		#endif
+
+		/*
+		*  Description:
+		*	Gets the 16 character name of the current program type, using the RBDS names
+		*	in North America and the RDS names in Europe (see setLocale()).
+		* Parameters:
+		*	programType - A string of at least 17 characters for the name. 
+		*		It is left empty until the station has sent a group.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_PTY)
+		void getProgramType(char * programType);
+		#endif
+
+		/*
+		*  Description:
+		*	Gives read-only access to the RDS information without copying it.
+		*	The strings are updated in place by readRDS(), use rdsChanges() to find out when.
+		*	radioText() is the last complete message: it only changes once every segment of the
+		*	next message has been received (EVENT_RADIOTEXT is sent then).
+		*/
+		#if defined(USE_SI4735_RDS)
+		const char * programService(void);
+		const char * radioText(void);
+		const char * callSign(void);
+		byte programType(void);			//The program type code, see getProgramType() for the name
+		word programIdentification(void);
+		#endif
+
+		/*
+		*  Description:
+		*	Gets the program type name (PTYN) sent in group 10A, a more specific description of the
+		*	program type (for example "Football" for the Sport type). It is empty until the station sends one.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_PTYN)
+		const char * programTypeName(void);
+		#endif
+
+		/*
+		*  Description:
+		*	Gets the title and artist of the item being played, as tagged in the RadioText with RT+.
+		* Parameters:
+		*	title, artist - Receive the text, at most size - 1 characters and the terminating null.
+		* Returns:
+		*	True if the station has tagged the item.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_RTPLUS)
+		bool getTitle(char * title, byte size);
+		bool getArtist(char * artist, byte size);
+		#endif
+
+		/*
+		*  Description:
+		*	Gets the program service names of the other networks announced by the station in group 14A.
+		* Parameters:
+		*	networks - Receives up to size networks.
+		* Returns:
+		*	The number of networks copied.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_EON)
+		byte getOtherNetworks(RDSOtherNetwork * networks, byte size);
+		#endif
+
+		/*
+		*  Description:
+		*	Gets the extended country code and the language code sent in group 1A, 0 until received.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_SLOW_LABELS)
+		byte extendedCountryCode(void);
+		byte languageCode(void);
+		#endif
+
+		/*
+		*  Description:
+		*	Gets the RDS fields that have changed since the last call, so that only those have to be redrawn.
+		* Returns:
+		*	A combination of the RDS_CHANGED_* bits. Every bit is set after a tune or seek.
+		*/
+		#if defined(USE_SI4735_RDS)
+		byte rdsChanges(void);
+		#endif
+
 		/*
 		*  Description:
 		*	Pulls the RDS information from the private variable and copies them locally. 
@@ -229,11 +753,27 @@ class Si4735// : public SPIClass
 		/*
 		*  Description:
 		*	Retreives the Time time that is broadcasted from the tuned station.
+		*	The date and time are local, the offset sent by the station is carried into the date.
+		*	Every field is 0 until a valid clock-time group has been received.
 		*/
 		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_DATE_TIME)
 		void getTime(Today * date);
 		#endif
 
+		/*
+		*  Description:
+		*	Retreives the clock time as sent by the station: UTC date and time plus the local offset.
+		* Parameters:
+		*	time - Receives the clock time.
+		*	age - If not 0, receives the time (in ms) since the clock-time group was received.
+		*		Stations send one a minute, add the age to the time for a running clock.
+		* Returns:
+		*	True if a valid clock-time group has been received since the last tune.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_DATE_TIME)
+		bool getClockTime(RDSTime * time, unsigned long * age);
+		#endif
+
 		/*
 		*  Description:
 		*	Retreives the Received Signal Quality Parameters/Metrics.
@@ -242,6 +782,45 @@ class Si4735// : public SPIClass
 		void getRSQ(Metrics * RSQ);
 		#endif	
 
+		/*
+		*  Description:
+		*	Gets the alternative frequencies (AF) the tuned station sends in group 0A: other transmitters
+		*	of the same program. Lists sent with method A and method B are both understood.
+		* Parameters:
+		*	frequencies - Receives up to size frequencies, in 10kHz.
+		* Returns:
+		*	The number of frequencies copied.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_AF)
+		byte getAlternativeFrequencies(word * frequencies, byte size);
+		#endif
+
+		/*
+		*  Description:
+		*	Turns station following on or off. While it is on, checkFollowing() moves the radio to
+		*	another transmitter of the same program when the signal becomes weak.
+		* Parameters:
+		*	threshold - The RSSI (dBuV) below which the alternative frequencies are tried, 0 turns following off.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_AF) && defined(USE_SI4735_RSQ)
+		void enableFollowing(byte threshold);
+		#endif
+
+		/*
+		*  Description:
+		*	Checks the signal of the tuned station, at most every AF_CHECK_INTERVAL ms. Call this from loop().
+		*	If the RSSI is below the threshold, the alternative frequencies collected for the station's PI code
+		*	are tried one after the other. Each one costs a tune and an RSQ read (about 60 ms of audio),
+		*	the PI code is only waited for on one that is at least AF_MARGIN stronger, and the switch is
+		*	kept only if the PI code matches. Otherwise the radio returns to the original frequency and
+		*	does not search again for AF_RETRY_INTERVAL ms.
+		* Returns:
+		*	True if the radio switched to an alternative frequency. The RDS information is kept.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_AF) && defined(USE_SI4735_RSQ)
+		bool checkFollowing(void);
+		#endif
+
 		/*
 		* Description:
 		*	Sets the volume. If of of the 0 - 63 range, no change will be made.
@@ -306,6 +885,17 @@ class Si4735// : public SPIClass
 		*/
 		void getResponse(char * response);
 
+		/*
+		* Description:
+		*	Gets only the first bytes of the response. Most commands answer with fewer than 16 bytes
+		*	(GET_PROPERTY with 4, RSQ_STATUS with 8), so there is no need to clock out the rest.
+		*	Use getStatus() when only the status byte is needed.
+		* Parameters:
+		*	response - A string for the response from the radio to be stored in.
+		*	length - The number of bytes to read, including the status byte (at most 16).
+		*/
+		void getResponse(char * response, byte length);
+
 		/*
 		* Description:
 		*	Powers down the radio
@@ -359,23 +949,250 @@ class Si4735// : public SPIClass
 		*/
 		word getProperty(word address);
 
+		/*
+		* Description:
+		*	Opens a batch of property writes, discarding anything staged before.
+		*/
+		void beginProperties(void);
+
+		/*
+		* Description:
+		*	Stages a property write. Staging the same property twice keeps only the last value.
+		* Returns:
+		*	false if the batch already holds PROPERTY_BATCH_SIZE properties.
+		*/
+		bool stageProperty(word address, word value);
+
+		/*
+		* Description:
+		*	Stages every property of a profile (an array in program memory ending with PROFILE_END).
+		* Returns:
+		*	false if some of the properties did not fit in the batch.
+		*/
+		bool stageProfile(const Property * profile);
+
+		/*
+		* Description:
+		*	Writes the staged properties. Each write only waits for CTS, and values the radio already
+		*	holds are not written again.
+		* Returns:
+		*	The number of writes that failed. getBatchErrors() tells which ones.
+		*/
+		byte commitProperties(void);
+
+		/*
+		* Description:
+		*	Gets the writes of the last commitProperties() that failed.
+		* Returns:
+		*	A bitmask with bit n set if the n-th staged property could not be written.
+		*/
+		byte getBatchErrors(void);
+
+		/*
+		* Description:
+		*	Writes every property of a profile (an array in program memory ending with PROFILE_END),
+		*	for example PROFILE_LW or PROFILE_EU.
+		* Returns:
+		*	The number of writes that failed.
+		*/
+		byte applyProfile(const Property * profile);
+
+		/*
+		* Description:
+		*	Gets the property cache counters. setProperty() skips writes of a value the radio already
+		*	holds and getProperty() answers from RAM for every property that has been written or read before.
+		*/
+		#if defined(USE_SI4735_PROPERTY_CACHE)
+		void getCacheStats(CacheStats * stats);
+		#endif
+
+		/*
+		* Description:
+		*	Clears the property cache counters.
+		*/
+		#if defined(USE_SI4735_PROPERTY_CACHE)
+		void resetCacheStats(void);
+		#endif
+
+		/*
+		* Description:
+		*	Forgets every cached property. This is done by begin(), end() and sendCommand(char *);
+		*	call it after changing the radio's properties by any other means.
+		*/
+		#if defined(USE_SI4735_PROPERTY_CACHE)
+		void clearPropertyCache(void);
+		#endif
+
+		/*
+		* Description:
+		*	Gets the number of bus transactions and bytes moved since the last resetBusStats().
+		*/
+		#if defined(USE_SI4735_BUS_STATS)
+		void getBusStats(BusStats * stats);
+		#endif
+
+		/*
+		* Description:
+		*	Clears the bus counters.
+		*/
+		#if defined(USE_SI4735_BUS_STATS)
+		void resetBusStats(void);
+		#endif
+
+		/*
+		* Description:
+		*	Gets the RDS reception counters collected by readRDS(), drainRDS() and startRdsRead().
+		*	The times to the first program service name and RadioText are measured as the groups are
+		*	read, so they include the time the groups waited in the FIFO.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_RDS_STATS)
+		void getRDSStats(RDSStats * stats);
+		#endif
+
+		/*
+		* Description:
+		*	Clears the RDS reception counters. The times since the last tune are kept, a tune clears them.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_RDS_STATS)
+		void resetRDSStats(void);
+		#endif
+
+		/*
+		* Description:
+		*	Gets the station cache counters. A hit is a return to a cached station, where the
+		*	program service name, program type and RadioText are shown as soon as the PI code is received.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_STATION_CACHE)
+		void getStationCacheStats(CacheStats * stats);
+		#endif
+
+		/*
+		* Description:
+		*	Forgets every cached station.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_STATION_CACHE)
+		void clearStationCache(void);
+		#endif
+
+		/*
+		* Description:
+		*	Starts recording the traffic with the radio in the format described in Si4735_Capture.h.
+		*	The capture header is written to the sink straight away, then each record as it happens.
+		*	The sink is called from the library's own calls (never from the interrupt handler) and
+		*	the time it takes is added to the radio's timing, so it should be quick.
+		* Parameters:
+		*	sink - Receives the capture.
+		*	sources - CAPTURE_BUS to record every command and response, CAPTURE_GROUPS to record
+		*		the RDS groups alone (enough to replay the RDS decoding), or both.
+		*/
+		#if defined(USE_SI4735_CAPTURE)
+		void startCapture(CaptureSink sink, byte sources);
+		#endif
+
+		/*
+		* Description:
+		*	Writes the status reads still being counted and stops recording.
+		*/
+		#if defined(USE_SI4735_CAPTURE)
+		void stopCapture(void);
+		#endif
+
 	private:
 	
 		char _mode; 			//Contains the Current Radio mode [AM,FM,SW,LW]		
 		char _volume;				//Current Volume
-		//word _frequency;			//Current Frequency
-		char _disp[65]; 			//Radio Text String
-		char _ps[9]; 				//Program Service String
-		char _csign[5]; 			//Call Sign
-		bool _ab; 					//Indicates new radioText		
-		char _pty[17];				//Program Type String
-		byte _year;					//Contains the month
-		byte _month;				//Contains the year
-		byte _day;					//Contains the day
-		byte _hour;					//Contains the hour
-		byte _minute; 				//Contains the minute
+		TuneResult _tuned;			//Station reported by the last completed tune/seek
+		#if defined(USE_SI4735_SEEK)
+		bool _tunedStale;			//seekUp()/seekDown() has not been read back, _tuned is the station it left
+		#endif
 		byte _locale; 				//Contains the locale [NA, EU]	
-		bool _newRadioText;		//Indicates that a new RadioText has been received
+		byte _error;				//Result of the last command [SI4735_OK, SI4735_TIMEOUT, SI4735_ERROR]
+		#if defined(USE_SI4735_RDS)
+		RDSDecoder _decoder;
+		RDSData _rds;				//Station information decoded from the RDS groups
+		#endif
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_STATION_CACHE)
+		RDSStationCache _stations;	//Stations the radio has been tuned to before
+		bool _stationChecked;		//The station cache has been searched for the tuned station
+		#endif
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_DATE_TIME)
+		unsigned long _timeReceived;	//millis() when the last clock-time group was decoded
+		#endif
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_AF) && defined(USE_SI4735_RSQ)
+		//Alternative frequencies of one network (PI code), collected from every transmitter it was received on
+		word _networkPI;
+		byte _networkCodes[AF_LIST_SIZE];
+		byte _networkCount;
+		word _networkRejected;		//Bit n is set if _networkCodes[n] sent another PI code
+		byte _followThreshold;		//RSSI below which checkFollowing() searches, 0 if following is off
+		unsigned long _followChecked;	//millis() of the last signal check
+		word _followWait;			//Time until the next signal check
+		#endif
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_RDS_STATS)
+		RDSStats _rdsStats;
+		unsigned long _tunedAt;		//millis() when the last tune started, and then when it completed
+		#endif
+		byte _rdsGroups;			//Groups decoded by the current RDS read
+		byte _rdsDropped;			//FIFO overruns reported during the current RDS read
+
+		//State of the operation run by poll()
+		byte _op;					//Operation in progress
+		byte _opState;				//Step of the operation [STATE_IDLE, STATE_WAIT_CTS, ...]
+		byte _opHandle;				//Handle of the most recent operation
+		byte _opResult;				//Result of the most recent operation
+		unsigned long _opStart;		//millis() when the operation (or its current step) started
+		word _opTimeout;			//Time allowed for the operation
+		CompletionCallback _callback;	//Called when an operation completes
+		EventCallback _eventHandler;	//Called by processEvents()
+		volatile bool _intPending;	//Set by signalInterrupt()
+		byte _intSources;			//Passed to enableInterrupts(), applied again by begin()
+
+		//Scan run by poll()
+		#if defined(USE_SI4735_SCAN)
+		ScanSink _scanSink;
+		word _scanFirst;
+		word _scanLast;
+		word _scanStep;
+		word _scanDone;				//Channels measured
+		byte _scanSettle;
+		bool _scanCancel;			//Set by cancelScan()
+		ScanStation * _scanList;	//Stations kept by findStations() when there is no sink
+		byte _scanListSize;
+		byte _scanListCount;
+		byte _scanRssi;				//Thresholds of findStations()
+		byte _scanSnr;
+		#endif
+		static Si4735 * _instance;	//Radio served by isr()
+
+		//Property writes staged by stageProperty()
+		Property _batch[PROPERTY_BATCH_SIZE];
+		byte _batchCount;
+		byte _batchErrors;
+
+		//Shadow copy of the properties written to or read from the radio
+		#if defined(USE_SI4735_PROPERTY_CACHE)
+		word _cacheAddress[PROPERTY_CACHE_SIZE];
+		word _cacheValue[PROPERTY_CACHE_SIZE];
+		byte _cacheCount;
+		word _cacheHits;
+		word _cacheMisses;
+		#endif
+
+		//Bus traffic counters
+		#if defined(USE_SI4735_BUS_STATS)
+		BusStats _bus;
+		#endif
+
+		//Capture in progress
+		#if defined(USE_SI4735_CAPTURE)
+		CaptureSink _captureSink;	//0 when nothing is recorded
+		byte _captureSources;
+		unsigned long _captureTime;	//micros() of the last record written
+		byte _captureStatus;		//Value of the last status read, if it was the last record
+		bool _captureStatusLast;
+		word _captureRepeats;		//Status reads counted since then
+		unsigned long _captureRepeatTime;	//micros() of the last of them
+		#endif
 		
 		/*
 		* Command string that holds the binary command string to be sent to the Si4735.
@@ -388,11 +1205,136 @@ class Si4735// : public SPIClass
 		* Parameters:
 		*	command - Binary command to be sent to the radio.
 		*	length - The number of characters in the command string (since it can't be null terminated!)
-		* TODO:
-		*	Make the command wait for a valid CTS response from the radio before releasing 				control of the CPU.
+		*	timeout - The maximum time (in ms) to wait for the radio to report CTS.
+		*		A timeout of 0 returns as soon as the command is written (used by poll()).
+		* Returns:
+		*	SI4735_OK once CTS is seen, SI4735_TIMEOUT or SI4735_ERROR otherwise.
+		*/
+		byte sendCommand(char * command, int length, word timeout = TIMEOUT_COMMAND);
+
+		/*
+		* Description:
+		*	Polls the status byte until all of the bits in mask are set.
+		*	If the status can not be read (STATUS_FLOATING) the whole timeout is waited instead,
+		*	as the fixed delays used to, so boards without the GPO1 diode keep working.
+		* Parameters:
+		*	mask - The status bits to wait for (STATUS_CTS, STATUS_STCINT, ...).
+		*	timeout - The maximum time (in ms) to wait.
+		* Returns:
+		*	SI4735_OK, SI4735_TIMEOUT or SI4735_ERROR. The result is also kept for getLastError().
+		*/
+		byte waitForStatus(byte mask, word timeout);
+
+		/*
+		* Description:
+		*	Sends the command held in the command buffer without waiting and hands it to poll().
+		* Returns:
+		*	The handle of the new operation, or 0 if another operation is in progress.
+		*/
+		byte startOp(byte op, int length, word timeout);
+
+		/*
+		* Description:
+		*	Records the result of the operation run by poll() and calls the completion callback.
+		*/
+		void finishOp(byte result);
+
+		/*
+		* Description:
+		*	Keeps the result of a tune or seek from its TUNE_STATUS response.
+		*/
+		void saveTune(const char * response);
+
+		/*
+		* Description:
+		*	Reads where a seekUp() or seekDown() landed if nothing has read it back yet.
+		*/
+		#if defined(USE_SI4735_SEEK)
+		void readStaleTune(void);
+		#endif
+
+		/*
+		* Description:
+		*	Interrupt handler attached to INT_PIN.
+		*/
+		static void isr(void);
+
+		/*
+		* Description:
+		*	Passes an event to the registered EventCallback.
+		*/
+		void dispatchEvent(byte event);
+
+		/*
+		* Description:
+		*	Configures the GPO lines, volume, RDS and band limits after POWER_UP.
+		*/
+		void configure(void);
+
+		/*
+		* Description:
+		*	Hands the group of an FM_RDS_STATUS response to the RDS decoder.
+		*/
+		#if defined(USE_SI4735_RDS)
+		void decodeRDS(char * response);
+		#endif
+
+		/*
+		* Description:
+		*	Adds the alternative frequencies of the tuned station to the network table,
+		*	starting a new table if the PI code has changed.
 		*/
-		void sendCommand(char * command, int length);
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_AF) && defined(USE_SI4735_RSQ)
+		void updateNetwork(void);
+		#endif
+
+		/*
+		* Description:
+		*	Tunes like tuneFrequency() but keeps the RDS information, used to move within a network.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_AF) && defined(USE_SI4735_RSQ)
+		byte tuneAlternative(word frequency);
+		#endif
+
+		/*
+		* Description:
+		*	Waits (at most timeout ms) for the first group of the tuned frequency whose block A could be corrected.
+		*	The groups received before the call are discarded.
+		* Returns:
+		*	Its PI code, the group is left in response. 0 if no such group arrived in time.
+		*/
+		#if defined(USE_SI4735_RDS)
+		word readPI(char * response, word timeout);
+		#endif
+
+		/*
+		* Description:
+		*	Waits (at most AF_PI_TIMEOUT ms) for the first group of the tuned frequency.
+		* Returns:
+		*	True if its PI code is pi, the group is then decoded.
+		*/
+		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_AF) && defined(USE_SI4735_RSQ)
+		bool checkPI(word pi);
+		#endif
 		
+		/*
+		* Description:
+		*	Sets up the bus hardware selected with the SI4735_BUS_* options.
+		*/
+		inline void busBegin(void);
+
+		/*
+		* Description:
+		*	Writes a binary command to the radio over the selected bus.
+		*/
+		inline void busWrite(const char * data, int length);
+
+		/*
+		* Description:
+		*	Reads the status byte (length 1) or the status byte and response (length > 1) over the selected bus.
+		*/
+		inline void busRead(char * data, byte length);
+
 		/*
 		* Description:
 		*	Sends/Receives a character from the SPI bus.
@@ -401,24 +1343,160 @@ class Si4735// : public SPIClass
 		* Returns:
 		*	The character read from the SPI bus during the transfer.
 		*/
-		char spiTransfer(char value);	
+		#if !defined(SI4735_BUS_I2C)
+		inline char spiTransfer(char value);
+		#endif
+
+		/*
+		*  Description:
+		*	Writes one record to the capture sink, or counts a status read that repeats the one before.
+		*/
+		#if defined(USE_SI4735_CAPTURE)
+		void capture(byte type, const void * data, byte length);
+		#endif
+
+		/*
+		*  Description:
+		*	Adds a channel measured by findStations() to its list if it passes the thresholds.
+		*/
+		#if defined(USE_SI4735_SCAN)
+		void listStation(const ScanRecord * record);
+		#endif
+
+		/*
+		*  Description:
+		*	Writes the CAPTURE_REPEAT record of the status reads counted so far.
+		*/
+		#if defined(USE_SI4735_CAPTURE)
+		void flushCapture(void);
+		#endif
 		
 		/*
 		*  Description:
 		*	converts the integer pty value to the 16 character string Program Type.
+		*	The names are kept in program memory and copied to name.
 		*/
 		#if defined(USE_SI4735_RDS) && defined(USE_SI4735_PTY)
-		void ptystr(byte);
+		void ptystr(byte pty, char * name);
 		#endif
 		
 		/*
 		*  Description:
-		*	Filters the sting str to only contain printable characters.
-		*	Any character that is not a normal character is converted to a space.
-		* 	This helps with filtering out noisy strings.
+		*	Finds a property in the property cache.
+		*  Returns:
+		*	The slot holding the property, or -1 if it is not cached.
+		*/
+		#if defined(USE_SI4735_PROPERTY_CACHE)
+		int findProperty(word address);
+		#endif
 
+		/*
+		*  Description:
+		*	Stores a property value in the given cache slot, or in a new slot if slot is -1.
 		*/
-		void printable_str(char * str, int length);		
+		#if defined(USE_SI4735_PROPERTY_CACHE)
+		void cacheProperty(int slot, word address, word value);
+		#endif		
 };
 
-#endif
\ No newline at end of file
+/*******************************************
+*
+* Bus Functions
+*
+* These are defined here so that the compiler can inline them into every command.
+*
+*******************************************/
+
+#if defined(SI4735_BUS_I2C)
+void Si4735::busBegin(void){
+	Wire.begin();
+}
+
+void Si4735::busWrite(const char * data, int length){
+	//Commands are written as they are, there is no need to pad them in 2-wire mode
+	Wire.beginTransmission(SI4735_I2C_ADDRESS);
+	Wire.write((const uint8_t *)data, length);
+	Wire.endTransmission();
+	#if defined(USE_SI4735_BUS_STATS)
+	_bus.transactions++;
+	_bus.bytesWritten += length;
+	#endif
+	#if defined(USE_SI4735_CAPTURE)
+	if(_captureSources & CAPTURE_BUS) capture(CAPTURE_COMMAND, data, length);
+	#endif
+}
+
+void Si4735::busRead(char * data, byte length){
+	//The status byte is always the first byte read
+	Wire.requestFrom((uint8_t)SI4735_I2C_ADDRESS, length);
+	for(byte i=0; i<length; i++) data[i] = Wire.read();
+	#if defined(USE_SI4735_BUS_STATS)
+	_bus.transactions++;
+	_bus.bytesRead += length;
+	#endif
+	#if defined(USE_SI4735_CAPTURE)
+	if(_captureSources & CAPTURE_BUS) capture(CAPTURE_RESPONSE, data, length);
+	#endif
+}
+#else
+void Si4735::busBegin(void){
+	#if defined(SI4735_BUS_SPI)
+	SPI.begin();
+	SPI.setClockDivider(SPI_CLOCK_DIV4);
+	#elif defined(SI4735_BUS_AVR_SPI)
+	pinMode(DATAOUT, OUTPUT);
+	pinMode(SPICLOCK,OUTPUT);
+	SPCR = (1<<SPE)|(1<<MSTR);//|(1<<SPR1)|(1<<SPR0);	//Enable SPI HW, Master Mode	
+	#endif
+}
+
+//The radio needs a few nanoseconds between SS and the first clock edge, digitalWrite() alone takes
+//longer than that, so no delay is needed around the transfers.
+void Si4735::busWrite(const char * data, int length){
+	digitalWrite(SS, LOW);
+	spiTransfer(0x48);  //Contrl byte to write an SPI command (now send 8 bytes)
+	for(int i=0; i<length; i++)spiTransfer(data[i]);
+	for(int i=length; i<8; i++)spiTransfer(0x00);  //Fill the rest of the command arguments with 0
+	digitalWrite(SS, HIGH);  //End the sequence
+	#if defined(USE_SI4735_BUS_STATS)
+	_bus.transactions++;
+	_bus.bytesWritten += 9;
+	#endif
+	#if defined(USE_SI4735_CAPTURE)
+	if(_captureSources & CAPTURE_BUS) capture(CAPTURE_COMMAND, data, length);
+	#endif
+}
+
+void Si4735::busRead(char * data, byte length){
+	digitalWrite(SS, LOW);
+	//0xA0 reads the status byte only, 0xE0 reads the status byte followed by the response.
+	//The read may stop after any byte, only the bytes the caller needs are clocked out.
+	spiTransfer((length == 1) ? 0xA0 : 0xE0);
+	for(byte i=0; i<length; i++)data[i] = spiTransfer(0x00);
+	digitalWrite(SS, HIGH);
+	#if defined(USE_SI4735_BUS_STATS)
+	_bus.transactions++;
+	_bus.bytesWritten++;
+	_bus.bytesRead += length;
+	#endif
+	#if defined(USE_SI4735_CAPTURE)
+	if(_captureSources & CAPTURE_BUS) capture(CAPTURE_RESPONSE, data, length);
+	#endif
+}
+
+char Si4735::spiTransfer(char value){
+	#if defined(SI4735_HOST)
+	return RadioSim.transfer(value);	// The simulated radio answers in place of the SPI hardware
+	#elif defined(SI4735_BUS_SPI)
+	return SPI.transfer(value);
+	#else
+	SPDR = value;                    // Start the transmission
+	while (!(SPSR & (1<<SPIF)))     // Wait for the end of the transmission
+	{
+	};
+	return SPDR;                    // return the received byte
+	#endif
+}
+#endif
+
+#endif
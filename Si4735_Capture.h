@@ -0,0 +1,109 @@
+/* Arduino Si4735 Library - Capture Format
+ *
+ * A capture records what the library exchanged with the radio so it can be replayed on a PC
+ * (see Si4735Sim::replay() in Si4735_Host.h). It is written record by record to a CaptureSink,
+ * for example Serial or a file on an SD card, so the Arduino never holds more than one record.
+ *
+ * A capture starts with a 5 byte header: 'S' '4' 'C', the format version and the CAPTURE_* sources
+ * that were recorded. Each record that follows is:
+ *	1 byte		Record type in bits 7:5, payload length (0 - 31) in bits 4:0
+ *	1-5 bytes	Time since the previous record (or the start of the capture) in us, 7 bits per byte,
+ *				least significant first, bit 7 set on every byte but the last
+ *	payload		CAPTURE_COMMAND: the command bytes, without the padding
+ *				CAPTURE_RESPONSE: the bytes read, the status byte first (1 byte for a status read)
+ *				CAPTURE_REPEAT: the number of times the previous status read was repeated (1 or 2 bytes, LSB first)
+ *				CAPTURE_GROUP: blocks A to D (high byte first) and the block error levels, as in FM_RDS_STATUS
+ *
+ * Status reads that return the same value as the one before are counted rather than recorded,
+ * so waiting for CTS or STC takes a few bytes however long the radio takes.
+*/
+
+#ifndef Si4735_Capture_h
+#define Si4735_Capture_h
+
+//Sources that can be recorded, passed to startCapture()
+#define CAPTURE_BUS		0x01	//Commands, responses and status reads
+#define CAPTURE_GROUPS	0x02	//RDS groups, as they are decoded
+
+//Record types
+#define CAPTURE_COMMAND		1
+#define CAPTURE_RESPONSE	2
+#define CAPTURE_REPEAT		3
+#define CAPTURE_GROUP		4
+
+#define CAPTURE_VERSION		1
+#define CAPTURE_HEADER_LENGTH	5
+//Longest record: the header byte, a 5 byte time and a 16 byte response
+#define CAPTURE_RECORD_MAX	22
+
+//Called with the capture header and then with each record. The data is only valid during the call.
+typedef void (*CaptureSink)(const byte * data, byte length);
+
+//One record read back from a capture
+typedef struct CaptureRecord {
+	byte type;
+	byte length;			//Payload length
+	unsigned long time;		//Time since the start of the capture (in us)
+	const byte * data;		//Payload
+} CaptureRecord;
+
+//Writes the capture header to header and returns its length
+inline byte captureHeader(byte * header, byte sources){
+	header[0] = 'S';
+	header[1] = '4';
+	header[2] = 'C';
+	header[3] = CAPTURE_VERSION;
+	header[4] = sources;
+	return CAPTURE_HEADER_LENGTH;
+}
+
+//Writes one record to record (at least CAPTURE_RECORD_MAX bytes) and returns its length
+inline byte captureRecord(byte * record, byte type, unsigned long elapsed, const void * payload, byte length){
+	byte size = 0;
+	record[size++] = (type << 5) | length;
+	while(elapsed > 0x7F){
+		record[size++] = (elapsed & 0x7F) | 0x80;
+		elapsed >>= 7;
+	}
+	record[size++] = elapsed;
+	memcpy(record + size, payload, length);
+	return size + length;
+}
+
+/*
+* Description:
+*	Checks the capture header.
+* Returns:
+*	The recorded CAPTURE_* sources, 0 if data does not start with a capture header.
+*/
+inline byte captureSources(const byte * data, unsigned long length){
+	if(length < CAPTURE_HEADER_LENGTH || data[0] != 'S' || data[1] != '4' || data[2] != 'C') return 0;
+	if(data[3] != CAPTURE_VERSION) return 0;
+	return data[4];
+}
+
+/*
+* Description:
+*	Reads the record at offset into record, time is the time of the record before it.
+* Returns:
+*	The offset of the next record, 0 at the end of the capture or if the record is cut short.
+*/
+inline unsigned long captureNext(const byte * data, unsigned long length, unsigned long offset,
+		unsigned long time, CaptureRecord * record){
+	unsigned long elapsed = 0;
+	byte shift = 0;
+	if(offset >= length) return 0;
+	record->type = data[offset] >> 5;
+	record->length = data[offset++] & 0x1F;
+	do{
+		if(offset >= length || shift > 28) return 0;
+		elapsed |= (unsigned long)(data[offset] & 0x7F) << shift;
+		shift += 7;
+	}while(data[offset++] & 0x80);
+	if(offset + record->length > length) return 0;
+	record->time = time + elapsed;
+	record->data = data + offset;
+	return offset + record->length;
+}
+
+#endif
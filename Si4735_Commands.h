@@ -0,0 +1,219 @@
+/* Arduino Si4735 Library - Command Encoders and Response Decoders
+ *
+ * Every command the library sends is built by one of the functions below and every response
+ * it reads is decoded through one of the response structures. Each encoder takes exactly the
+ * arguments its command needs and returns the command length, so a command can not be built
+ * with missing arguments or sent with the wrong length. The response structures are checked
+ * against the response lengths in AN332 when the library is compiled.
+ * Learn more about the commands in the Si4735 Programming Guide (AN332).
+*/
+
+#ifndef Si4735_Commands_h
+#define Si4735_Commands_h
+
+//Command codes
+#define CMD_POWER_UP		0x01
+#define CMD_GET_REV		0x10
+#define CMD_POWER_DOWN		0x11
+#define CMD_SET_PROPERTY	0x12
+#define CMD_GET_PROPERTY	0x13
+#define CMD_FM_TUNE_FREQ	0x20
+#define CMD_FM_SEEK_START	0x21
+#define CMD_FM_TUNE_STATUS	0x22
+#define CMD_FM_RSQ_STATUS	0x23
+#define CMD_FM_RDS_STATUS	0x24
+#define CMD_AM_TUNE_FREQ	0x40
+#define CMD_AM_SEEK_START	0x41
+#define CMD_AM_TUNE_STATUS	0x42
+#define CMD_AM_RSQ_STATUS	0x43
+#define CMD_GPIO_CTL		0x80
+#define CMD_GPIO_SET		0x81
+
+//The AM commands are the FM commands with bit 6 set
+#define CMD_AM	0x20
+
+/*******************************************
+*
+* Command Encoders
+*
+* Each one writes the command to cmd and returns its length.
+*
+*******************************************/
+
+//POWER_UP with GPO2 (INT) enabled, the crystal oscillator running and the analog audio outputs enabled
+inline byte cmdPowerUp(char * cmd, char mode){
+	cmd[0] = CMD_POWER_UP;
+	cmd[1] = (mode == FM) ? 0x50 : 0x51;
+	cmd[2] = 0x05;
+	return 3;
+}
+
+//Commands without arguments (GET_REV, POWER_DOWN)
+inline byte cmdNoArgs(char * cmd, byte code){
+	cmd[0] = code;
+	return 1;
+}
+
+//GPIO_CTL and GPIO_SET, mask holds the GPO1 (0x02), GPO2 (0x04) and GPO3 (0x08) bits
+inline byte cmdGpio(char * cmd, byte code, byte mask){
+	cmd[0] = code;
+	cmd[1] = mask;
+	return 2;
+}
+
+inline byte cmdSetProperty(char * cmd, word address, word value){
+	cmd[0] = CMD_SET_PROPERTY;
+	cmd[1] = 0x00;
+	cmd[2] = address >> 8;
+	cmd[3] = address & 0xFF;
+	cmd[4] = value >> 8;
+	cmd[5] = value & 0xFF;
+	return 6;
+}
+
+inline byte cmdGetProperty(char * cmd, word address){
+	cmd[0] = CMD_GET_PROPERTY;
+	cmd[1] = 0x00;
+	cmd[2] = address >> 8;
+	cmd[3] = address & 0xFF;
+	return 4;
+}
+
+//FM_TUNE_FREQ or AM_TUNE_FREQ
+inline byte cmdTuneFreq(char * cmd, char mode, word frequency){
+	cmd[0] = (mode == FM) ? CMD_FM_TUNE_FREQ : CMD_AM_TUNE_FREQ;
+	cmd[1] = 0x00;
+	cmd[2] = frequency >> 8;
+	cmd[3] = frequency & 0xFF;
+	if(mode == FM) return 4;
+	//AM_TUNE_FREQ also takes the antenna capacitor (0 = automatic)
+	cmd[4] = 0x00;
+	cmd[5] = 0x00;
+	return 6;
+}
+
+//FM_SEEK_START or AM_SEEK_START
+inline byte cmdSeekStart(char * cmd, char mode, bool up, bool wrap){
+	cmd[0] = (mode == FM) ? CMD_FM_SEEK_START : CMD_AM_SEEK_START;
+	cmd[1] = (up ? 0x08 : 0x00) | (wrap ? 0x04 : 0x00);
+	if(mode == FM) return 2;
+	//AM_SEEK_START also takes the antenna capacitor (0 = automatic)
+	cmd[2] = 0x00;
+	cmd[3] = 0x00;
+	cmd[4] = 0x00;
+	cmd[5] = 0x00;
+	return 6;
+}
+
+//FM_TUNE_STATUS or AM_TUNE_STATUS, intack clears the STC interrupt
+inline byte cmdTuneStatus(char * cmd, char mode, bool intack){
+	cmd[0] = (mode == FM) ? CMD_FM_TUNE_STATUS : CMD_AM_TUNE_STATUS;
+	cmd[1] = intack ? 0x01 : 0x00;
+	return 2;
+}
+
+//FM_RSQ_STATUS or AM_RSQ_STATUS, intack clears the RSQ interrupt
+inline byte cmdRsqStatus(char * cmd, char mode, bool intack){
+	cmd[0] = (mode == FM) ? CMD_FM_RSQ_STATUS : CMD_AM_RSQ_STATUS;
+	cmd[1] = intack ? 0x01 : 0x00;
+	return 2;
+}
+
+//FM_RDS_STATUS, intack clears the RDS interrupt and mtfifo empties the RDS FIFO
+inline byte cmdRdsStatus(char * cmd, bool intack, bool mtfifo){
+	cmd[0] = CMD_FM_RDS_STATUS;
+	cmd[1] = (mtfifo ? 0x02 : 0x00) | (intack ? 0x01 : 0x00);
+	return 2;
+}
+
+/*******************************************
+*
+* Response Decoders
+*
+* The structures match the layout of the response bytes, so a response can be read straight into them.
+*
+*******************************************/
+
+//GET_REV
+typedef struct RevResponse {
+	byte status;
+	byte partNumber;
+	char firmware[2];		//Major and minor firmware revision (ascii)
+	char patch[2];
+	char component[2];		//Major and minor component revision (ascii)
+	char chipRevision;		//ascii
+} RevResponse;
+
+//GET_PROPERTY
+typedef struct PropertyResponse {
+	byte status;
+	byte reserved;
+	byte valueHigh;
+	byte valueLow;
+
+	word value(void) const { return MAKEINT(valueHigh, valueLow); }
+} PropertyResponse;
+
+//FM_TUNE_STATUS and AM_TUNE_STATUS
+typedef struct TuneResponse {
+	byte status;
+	byte flags;
+	byte frequencyHigh;
+	byte frequencyLow;
+	byte rssi;
+	byte snr;
+	byte multipath;			//FM only (AM: antenna capacitor high byte)
+	byte antennaCap;
+
+	word frequency(void) const { return MAKEINT(frequencyHigh, frequencyLow); }
+	bool complete(void) const { return status & 0x01; }		//STCINT
+	bool bandLimit(void) const { return flags & 0x80; }		//BLTF: the seek hit the band limit
+	bool valid(void) const { return flags & 0x01; }			//The channel is a valid station
+} TuneResponse;
+
+//Bytes of TUNE_STATUS needed for the frequency alone (status, flags and frequency)
+#define TUNE_FREQUENCY_LENGTH	4
+
+//FM_RSQ_STATUS and AM_RSQ_STATUS
+typedef struct RsqResponse {
+	byte status;
+	byte interrupts;
+	byte flags;
+	byte stereo;			//FM only: PILOT in bit 7, STBLEND in bits 6:0
+	byte rssi;
+	byte snr;
+	byte multipath;			//FM only
+	int8_t frequencyOffset;	//FM only
+
+	byte stereoBlend(void) const { return stereo & 0x7F; }
+	bool pilot(void) const { return stereo & 0x80; }
+	bool valid(void) const { return flags & 0x01; }
+} RsqResponse;
+
+//FM_RDS_STATUS
+typedef struct RdsResponse {
+	byte status;
+	byte interrupts;		//RDSNEWBLOCKB, RDSNEWBLOCKA, RDSSYNCFOUND, RDSSYNCLOST, RDSRECV
+	byte sync;				//GRPLOST in bit 2, RDSSYNC in bit 0
+	byte fifoUsed;			//Groups in the RDS FIFO
+	byte blocks[8];			//Blocks A to D, high byte first
+	byte errors;			//Block error levels: BLEA in bits 7:6 ... BLED in bits 1:0
+
+	word block(byte index) const { return MAKEINT(blocks[index*2], blocks[index*2+1]); }
+	byte errorLevel(byte index) const { return (errors >> (6 - index*2)) & 0x03; }
+	bool synchronized(void) const { return sync & 0x01; }
+	bool syncLost(void) const { return interrupts & 0x02; }	//RDSSYNCLOST
+	bool groupLost(void) const { return sync & 0x04; }
+} RdsResponse;
+
+//Fails to compile if a structure does not match its response length (an array can not have a negative size).
+//A typedef rather than static_assert so the header still builds with the older avr-gcc.
+#define CHECK_RESPONSE_LENGTH(type, length)	typedef char type##Length[(sizeof(type) == (length)) ? 1 : -1]
+
+CHECK_RESPONSE_LENGTH(RevResponse, 9);
+CHECK_RESPONSE_LENGTH(PropertyResponse, 4);
+CHECK_RESPONSE_LENGTH(TuneResponse, 8);
+CHECK_RESPONSE_LENGTH(RsqResponse, 8);
+CHECK_RESPONSE_LENGTH(RdsResponse, 13);
+
+#endif
@@ -0,0 +1,600 @@
+/* Arduino Si4735 Library - Host Simulation
+ *
+ * See Si4735_Host.h for a description of the simulation.
+ * Nothing in this file is compiled unless SI4735_HOST is defined.
+*/
+#include "Si4735.h"
+
+#if defined(SI4735_HOST)
+
+Si4735Sim RadioSim;
+
+/*******************************************
+*
+* Arduino functions
+*
+*******************************************/
+
+unsigned long millis(void){
+	return RadioSim.now / 1000;
+}
+
+unsigned long micros(void){
+	return RadioSim.now;
+}
+
+void delay(unsigned long ms){
+	RadioSim.advance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us){
+	RadioSim.advance(us);
+}
+
+void pinMode(uint8_t, uint8_t){
+}
+
+void digitalWrite(uint8_t pin, uint8_t value){
+	//Only the slave select line is wired to the simulated radio
+	if(pin != SS) return;
+	if(value == LOW) RadioSim.select();
+	else RadioSim.deselect();
+}
+
+int digitalRead(uint8_t){
+	return LOW;
+}
+
+void attachInterrupt(uint8_t, void (*handler)(void), int){
+	RadioSim.isr = handler;
+}
+
+void detachInterrupt(uint8_t){
+	RadioSim.isr = 0;
+}
+
+/*******************************************
+*
+* Simulated Si4735
+*
+*******************************************/
+
+Si4735Sim::Si4735Sim(){
+	reset();
+}
+
+void Si4735Sim::reset(void){
+	now = 0;
+	//Typical figures from the Si4735 datasheet
+	ctsDelay = 300;
+	powerUpDelay = 110000;
+	stcDelay = 60000;
+	byteTime = 2;			//8 bits at 4 MHz
+	missedTunes = 0;
+	floatingMiso = false;
+	commands = 0;
+	statusReads = 0;
+	responseReads = 0;
+	busyWrites = 0;
+	rdsGroups = 0;
+	rdsOverflows = 0;
+	replayMismatches = 0;
+	isr = 0;
+	powered = false;
+	function = 0;
+	frequency = 0;
+	_stationCount = 0;
+	_propertyCount = 0;
+	_selected = false;
+	_count = 0;
+	_ctsAt = 0;
+	_stcAt = 0;
+	_stcPending = false;
+	_stcInt = false;
+	_err = false;
+	_bandLimit = false;
+	memset(_response, 0, sizeof(_response));
+	_capture = 0;
+	_replaySources = 0;
+	_repeatCount = 0;
+	clearRDS();
+}
+
+void Si4735Sim::addStation(word frequency, byte rssi, byte snr, word pi, const char * ps){
+	SimStation * added = &_stations[_stationCount];
+	if(_stationCount >= SIM_STATIONS) return;
+	added->frequency = frequency;
+	added->rssi = rssi;
+	added->snr = snr;
+	added->pi = pi;
+	memset(added->ps, ' ', 8);
+	if(ps) memcpy(added->ps, ps, strnlen(ps, 8));
+	added->ps[8] = '\0';
+	added->afCount = 0;
+	_stationCount++;
+}
+
+void Si4735Sim::setAlternativeFrequencies(word frequency, const word * frequencies, byte count){
+	SimStation * changed = station(frequency);
+	if(!changed) return;
+	if(count > SIM_AF) count = SIM_AF;
+	for(byte i=0; i<count; i++) changed->af[i] = (frequencies[i] - 8750) / 10;
+	changed->afCount = count;
+}
+
+void Si4735Sim::setSignal(word frequency, byte rssi, byte snr){
+	SimStation * changed = station(frequency);
+	if(!changed) return;
+	changed->rssi = rssi;
+	changed->snr = snr;
+}
+
+void Si4735Sim::raise(byte source){
+	if(powered && isr && (getProperty(0x0001) & source)) isr();
+}
+
+void Si4735Sim::advance(unsigned long us){
+	now += us;
+	if(_stcPending && now >= _stcAt){
+		_stcPending = false;
+		_stcInt = true;
+		//The decoder synchronizes on the new station from the end of the tune
+		_rdsAt = _stcAt + SIM_RDS_GROUP_TIME;
+		raise(STATUS_STCINT);
+	}
+	if(_replaySources == CAPTURE_GROUPS) replayGroups();
+	else while(!_stcPending && now >= _rdsAt) receiveRDS();
+}
+
+void Si4735Sim::receiveRDS(void){
+	const SimStation * tuned = station(frequency);
+	word * group;
+	byte first, second;
+
+	_rdsAt += SIM_RDS_GROUP_TIME;
+	if(!powered || function != 0 || !tuned || !tuned->pi) return;
+
+	group = queueRDS(0);
+	if(!group) return;
+	//AF method A: the number of AFs (224 + count) and the first AF, then the others two by two
+	if(_rdsPair == 0){
+		first = 224 + tuned->afCount;
+		second = tuned->afCount ? tuned->af[0] : 205;
+	}
+	else{
+		first = tuned->af[_rdsPair*2 - 1];
+		second = (_rdsPair*2 < tuned->afCount) ? tuned->af[_rdsPair*2] : 205;	//205 is the filler code
+	}
+	if(++_rdsPair > tuned->afCount / 2) _rdsPair = 0;
+
+	//Group 0A carrying the next two characters of the program service name
+	group[0] = tuned->pi;
+	group[1] = _rdsSegment;		//Group type 0A, PTY 0
+	group[2] = MAKEINT(first, second);
+	group[3] = MAKEINT((byte)tuned->ps[_rdsSegment*2], (byte)tuned->ps[_rdsSegment*2+1]);
+	_rdsSegment = (_rdsSegment + 1) & 3;
+	notifyRDS();
+}
+
+word * Si4735Sim::queueRDS(byte errors){
+	rdsGroups++;
+	if(_rdsCount >= SIM_RDS_FIFO){
+		rdsOverflows++;
+		_rdsLost = true;
+		return 0;
+	}
+	_rdsErrors[_rdsCount] = errors;
+	return _rdsFifo[_rdsCount++];
+}
+
+void Si4735Sim::notifyRDS(void){
+	//FM_RDS_INT_FIFO_COUNT sets how many groups must be waiting before RDSINT
+	if(_rdsCount >= getProperty(0x1501) && (getProperty(0x1500) & 0x01)){
+		_rdsInt = true;
+		raise(STATUS_RDSINT);
+	}
+}
+
+void Si4735Sim::clearRDS(void){
+	_rdsCount = 0;
+	_rdsSegment = 0;
+	_rdsPair = 0;
+	_rdsInt = false;
+	_rdsLost = false;
+	_rdsAt = (unsigned long)-1;
+}
+
+void Si4735Sim::select(void){
+	_selected = true;
+	_count = 0;
+	_control = 0;
+}
+
+void Si4735Sim::deselect(void){
+	if(_selected && _control == 0x48 && _count == 9){
+		if(_replaySources == CAPTURE_BUS) replayCommand();
+		else execute();
+	}
+	_selected = false;
+}
+
+byte Si4735Sim::transfer(byte value){
+	byte result = 0;
+	advance(byteTime);
+	if(!_selected) return 0xFF;
+	if(_count > 0 && floatingMiso && (_control == 0xA0 || _control == 0xE0)){
+		_count++;
+		return 0xFF;
+	}
+	if(_count == 0){
+		_control = value;
+		if(_control == 0xA0) statusReads++;
+		else if(_control == 0xE0) responseReads++;
+		//A replayed read is answered with the recorded bytes
+		if(_replaySources == CAPTURE_BUS){
+			if(_control == 0xA0) _response[0] = replayStatus();
+			else if(_control == 0xE0) replayResponse();
+		}
+	}
+	else{
+		switch(_control){
+			case 0x48:	//Command write
+				if(_count <= 8) _frame[_count-1] = value;
+				break;
+			case 0xA0:	//Status read
+				result = (_replaySources == CAPTURE_BUS) ? _response[0] : status();
+				break;
+			case 0xE0:	//Long response read
+				if(_replaySources != CAPTURE_BUS) _response[0] = status();
+				if(_count <= 16) result = _response[_count-1];
+				break;
+			default:
+				break;
+		}
+	}
+	_count++;
+	return result;
+}
+
+byte Si4735Sim::status(void){
+	byte value = 0;
+	if(now >= _ctsAt) value |= STATUS_CTS;
+	if(_err) value |= STATUS_ERR;
+	if(_stcInt) value |= STATUS_STCINT;
+	if(_rdsInt) value |= STATUS_RDSINT;
+	return value;
+}
+
+SimStation * Si4735Sim::station(word frequency){
+	for(byte i=0; i<_stationCount; i++){
+		if(_stations[i].frequency == frequency) return &_stations[i];
+	}
+	return 0;
+}
+
+void Si4735Sim::setProperty(word address, word value){
+	for(byte i=0; i<_propertyCount; i++){
+		if(_propertyAddress[i] == address){
+			_propertyValue[i] = value;
+			return;
+		}
+	}
+	if(_propertyCount >= SIM_PROPERTIES) return;
+	_propertyAddress[_propertyCount] = address;
+	_propertyValue[_propertyCount++] = value;
+}
+
+word Si4735Sim::getProperty(word address){
+	for(byte i=0; i<_propertyCount; i++){
+		if(_propertyAddress[i] == address) return _propertyValue[i];
+	}
+	//Power up defaults of the properties used by the library
+	switch(address){
+		case 0x1400: return 8750;	//FM_SEEK_BAND_BOTTOM
+		case 0x1401: return 10790;	//FM_SEEK_BAND_TOP
+		case 0x1402: return 10;		//FM_SEEK_FREQ_SPACING
+		case 0x1403: return 3;		//FM_SEEK_TUNE_SNR_THRESHOLD
+		case 0x1404: return 20;		//FM_SEEK_TUNE_RSSI_THRESHOLD
+		case 0x3400: return 520;	//AM_SEEK_BAND_BOTTOM
+		case 0x3401: return 1710;	//AM_SEEK_BAND_TOP
+		case 0x3402: return 10;		//AM_SEEK_FREQ_SPACING
+		case 0x4000: return 63;		//RX_VOLUME
+		default: return 0;
+	}
+}
+
+void Si4735Sim::execute(void){
+	byte cmd = _frame[0];
+	const SimStation * tuned;
+	word base = (function == 0) ? 0x1400 : 0x3400;
+
+	commands++;
+	if(now < _ctsAt) busyWrites++;
+	_ctsAt = now + ctsDelay;
+	_err = false;
+	memset(_response, 0, sizeof(_response));
+
+	//Only POWER_UP is accepted while the radio is powered down
+	if(!powered && cmd != 0x01){
+		_err = true;
+		return;
+	}
+
+	switch(cmd){
+		case 0x01:	//POWER_UP
+			powered = true;
+			function = _frame[1] & 0x0F;
+			frequency = 0;
+			_propertyCount = 0;
+			_stcPending = false;
+			_stcInt = false;
+			clearRDS();
+			_ctsAt = now + powerUpDelay;
+			break;
+		case 0x10:	//GET_REV
+			_response[1] = 35;
+			_response[2] = '2';
+			_response[3] = '0';
+			_response[6] = '2';
+			_response[7] = '0';
+			_response[8] = 'C';
+			break;
+		case 0x11:	//POWER_DOWN
+			powered = false;
+			break;
+		case 0x12:	//SET_PROPERTY
+			setProperty(MAKEINT(_frame[2], _frame[3]), MAKEINT(_frame[4], _frame[5]));
+			break;
+		case 0x13:	//GET_PROPERTY
+			_response[2] = getProperty(MAKEINT(_frame[2], _frame[3])) >> 8;
+			_response[3] = getProperty(MAKEINT(_frame[2], _frame[3])) & 0xFF;
+			break;
+		case 0x80:	//GPIO_CTL
+		case 0x81:	//GPIO_SET
+			break;
+		case 0x20:	//FM_TUNE_FREQ
+		case 0x40:	//AM_TUNE_FREQ
+			if(missedTunes) missedTunes--;
+			else frequency = MAKEINT(_frame[2], _frame[3]);
+			clearRDS();
+			_bandLimit = false;
+			_stcInt = false;
+			_stcPending = true;
+			_stcAt = _ctsAt + stcDelay;
+			break;
+		case 0x21:	//FM_SEEK_START
+		case 0x41:{	//AM_SEEK_START
+			bool up = bitRead(_frame[1], 3);
+			bool wrap = bitRead(_frame[1], 2);
+			word bottom = getProperty(base);
+			word top = getProperty(base + 1);
+			word spacing = getProperty(base + 2);
+			word start = frequency;
+			word channels = 0;
+			clearRDS();
+			_bandLimit = false;
+			while(true){
+				if(up) frequency += spacing;
+				else frequency -= spacing;
+				if(frequency > top || frequency < bottom){
+					if(!wrap){
+						frequency = up ? top : bottom;
+						_bandLimit = true;
+						break;
+					}
+					frequency = up ? bottom : top;
+				}
+				channels++;
+				tuned = station(frequency);
+				if(tuned && tuned->rssi >= getProperty(base + 4) && tuned->snr >= getProperty(base + 3)) break;
+				if(frequency == start){
+					_bandLimit = true;
+					break;
+				}
+			}
+			_stcInt = false;
+			_stcPending = true;
+			_stcAt = _ctsAt + stcDelay * channels;
+			break;
+		}
+		case 0x22:	//FM_TUNE_STATUS
+		case 0x42:	//AM_TUNE_STATUS
+		case 0x23:	//FM_RSQ_STATUS
+		case 0x43:{	//AM_RSQ_STATUS
+			bool done = !_stcPending || now >= _stcAt;
+			tuned = done ? station(frequency) : 0;
+			if((cmd & 0x0F) == 0x02){
+				if(bitRead(_frame[1], 0)) _stcInt = false;	//INTACK
+				_response[1] = (_bandLimit ? 0x80 : 0) | ((tuned) ? 0x01 : 0);
+				_response[2] = frequency >> 8;
+				_response[3] = frequency & 0xFF;
+				_response[4] = tuned ? tuned->rssi : 0;
+				_response[5] = tuned ? tuned->snr : 0;
+			}
+			else{
+				_response[2] = (tuned) ? 0x01 : 0;
+				_response[3] = (tuned && function == 0) ? 0x80 | 55 : 0;
+				_response[4] = tuned ? tuned->rssi : 0;
+				_response[5] = tuned ? tuned->snr : 0;
+			}
+			break;
+		}
+		case 0x24:	//FM_RDS_STATUS
+			if(bitRead(_frame[1], 0)) _rdsInt = false;	//INTACK
+			if(bitRead(_frame[1], 1)) _rdsCount = 0;	//MTFIFO
+			_response[1] = (_rdsCount) ? 0x01 : 0;		//RDSRECV
+			_response[2] = ((station(frequency) || _replaySources) ? 0x01 : 0) | (_rdsLost ? 0x04 : 0);	//RDSSYNC, GRPLOST
+			_response[3] = _rdsCount;
+			_rdsLost = false;
+			if(_rdsCount){
+				for(byte i=0; i<4; i++){
+					_response[4+i*2] = _rdsFifo[0][i] >> 8;
+					_response[5+i*2] = _rdsFifo[0][i] & 0xFF;
+				}
+				_response[12] = _rdsErrors[0];
+				_rdsCount--;
+				memmove(_rdsFifo[0], _rdsFifo[1], _rdsCount * sizeof(_rdsFifo[0]));
+				memmove(_rdsErrors, _rdsErrors + 1, _rdsCount);
+			}
+			break;
+		default:
+			_err = true;
+			break;
+	}
+}
+
+/*******************************************
+*
+* Capture replay
+*
+*******************************************/
+
+bool Si4735Sim::replay(const byte * data, unsigned long length, bool timed){
+	_replaySources = captureSources(data, length);
+	//A capture of the bus holds the RDS groups in the FM_RDS_STATUS responses
+	if(_replaySources & CAPTURE_BUS) _replaySources = CAPTURE_BUS;
+	_capture = _replaySources ? data : 0;
+	_captureLength = length;
+	_captureOffset = CAPTURE_HEADER_LENGTH;
+	_captureTime = 0;
+	_replayTimed = timed;
+	_replayStart = now;
+	_replayStatus = STATUS_CTS;
+	_repeatCount = 0;
+	replayMismatches = 0;
+	return _replaySources != 0;
+}
+
+bool Si4735Sim::replaying(void){
+	return _capture && (_captureOffset < _captureLength || _repeatCount);
+}
+
+//Reads the next record of a bus replay without using it, the RDS groups are skipped.
+//Returns the offset of the record after it, 0 at the end of the capture.
+unsigned long Si4735Sim::peekRecord(CaptureRecord * record){
+	unsigned long next;
+	while((next = captureNext(_capture, _captureLength, _captureOffset, _captureTime, record))){
+		if(record->type != CAPTURE_GROUP) return next;
+		_captureOffset = next;
+		_captureTime = record->time;
+	}
+	_captureOffset = _captureLength;
+	return 0;
+}
+
+void Si4735Sim::useRecord(const CaptureRecord * record, unsigned long next){
+	_captureOffset = next;
+	_captureTime = record->time;
+	if(_replayTimed) waitUntil(record->time);
+}
+
+//Drops the status reads the library did not make, remembering the last status
+void Si4735Sim::skipRecords(void){
+	CaptureRecord record;
+	unsigned long next;
+	_repeatCount = 0;
+	while((next = peekRecord(&record))){
+		if(record.type == CAPTURE_RESPONSE && record.length == 1) _replayStatus = record.data[0];
+		else if(record.type != CAPTURE_REPEAT) return;
+		_captureOffset = next;
+		_captureTime = record.time;
+	}
+}
+
+void Si4735Sim::waitUntil(unsigned long time){
+	if(now < _replayStart + time) advance(_replayStart + time - now);
+}
+
+byte Si4735Sim::replayStatus(void){
+	CaptureRecord record;
+	unsigned long next;
+	if(!_repeatCount){
+		next = peekRecord(&record);
+		if(next && record.type == CAPTURE_RESPONSE && record.length == 1){
+			useRecord(&record, next);
+			_replayStatus = record.data[0];
+		}
+		else if(next && record.type == CAPTURE_REPEAT){
+			_repeatCount = record.data[0] | ((record.length > 1) ? record.data[1] << 8 : 0);
+			_repeatDone = 0;
+			_repeatFrom = _captureTime;
+			_repeatTo = record.time;
+			_captureOffset = next;
+			_captureTime = record.time;
+		}
+		//Otherwise the library reads the status more often than it did when recording
+	}
+	if(_repeatCount){
+		//The repeated reads are spread evenly up to the time of the last one
+		_repeatDone++;
+		if(_replayTimed) waitUntil(_repeatFrom + (unsigned long long)(_repeatTo - _repeatFrom) * _repeatDone / _repeatCount);
+		if(_repeatDone == _repeatCount) _repeatCount = 0;
+	}
+	return _replayStatus;
+}
+
+void Si4735Sim::replayResponse(void){
+	CaptureRecord record;
+	unsigned long next;
+	skipRecords();
+	memset(_response, 0, sizeof(_response));
+	next = peekRecord(&record);
+	if(next && record.type == CAPTURE_RESPONSE){
+		useRecord(&record, next);
+		memcpy(_response, record.data, (record.length > 16) ? 16 : record.length);
+		_replayStatus = _response[0];
+	}
+	else{
+		replayMismatches++;
+		_response[0] = _replayStatus;
+	}
+}
+
+void Si4735Sim::replayCommand(void){
+	CaptureRecord record;
+	unsigned long next;
+	commands++;
+	//Skip the responses the library did not read
+	_repeatCount = 0;
+	while((next = peekRecord(&record)) && record.type != CAPTURE_COMMAND){
+		if(record.type == CAPTURE_RESPONSE) _replayStatus = record.data[0];
+		_captureOffset = next;
+		_captureTime = record.time;
+	}
+	if(!next){
+		replayMismatches++;
+		return;
+	}
+	useRecord(&record, next);
+	for(byte i=0; i<8; i++){
+		if(_frame[i] != ((i < record.length) ? record.data[i] : 0)){
+			replayMismatches++;
+			break;
+		}
+	}
+}
+
+void Si4735Sim::replayGroups(void){
+	CaptureRecord record;
+	unsigned long next;
+	word * group;
+	while((next = captureNext(_capture, _captureLength, _captureOffset, _captureTime, &record))){
+		if(record.type == CAPTURE_GROUP && record.length == 9){
+			if(_replayTimed){
+				if(now < _replayStart + record.time) return;
+			}
+			//As fast as possible: whenever the tuned radio has room for the group
+			else if(!powered || function != 0 || _stcPending || _rdsCount >= SIM_RDS_FIFO) return;
+			//With the recorded timing the groups that arrive during a tune are lost, as they would be
+			if(powered && function == 0 && !_stcPending && (group = queueRDS(record.data[8]))){
+				for(byte i=0; i<4; i++) group[i] = MAKEINT(record.data[i*2], record.data[i*2+1]);
+				notifyRDS();
+			}
+		}
+		_captureOffset = next;
+		_captureTime = record.time;
+	}
+	_captureOffset = _captureLength;
+}
+
+#endif //SI4735_HOST
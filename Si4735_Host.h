@@ -0,0 +1,247 @@
+/* Arduino Si4735 Library - Host Simulation
+ *
+ * This file is only used when the library is compiled on a PC with SI4735_HOST defined
+ * (for example: g++ -DSI4735_HOST Si4735.cpp Si4735_Host.cpp mysketch.cpp).
+ * It provides the few Arduino functions the library needs along with a simulated
+ * Si4735 that answers the SPI bus, so the library can be exercised and timed without hardware.
+ *
+ * Time is virtual. Every SPI byte and every delay() advances the clock, so measurements
+ * taken with millis()/micros() are repeatable from run to run.
+ *
+ * The simulated radio can also replay a capture recorded on an Arduino with Si4735::startCapture(),
+ * to reproduce what happened with a real radio.
+*/
+
+#ifndef Si4735_Host_h
+#define Si4735_Host_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef uint16_t word;
+typedef bool boolean;
+
+#define LOW		0
+#define HIGH	1
+#define INPUT	0
+#define OUTPUT	1
+#define FALLING	2
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+
+//Program memory is ordinary memory on the host
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_ptr(address) (*(void * const *)(address))
+#define strcpy_P(dest, src) strcpy((dest), (src))
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t number, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t number);
+#define digitalPinToInterrupt(pin)	(pin)
+
+#include "Si4735_Capture.h"
+
+//Maximum number of stations the simulated band can hold
+#define SIM_STATIONS	16
+//Maximum number of properties the simulated radio remembers
+#define SIM_PROPERTIES	32
+//Groups held by the RDS FIFO
+#define SIM_RDS_FIFO	25
+//Time taken to receive one RDS group (104 bits at 1187.5 bit/s, in us)
+#define SIM_RDS_GROUP_TIME	87579
+//Alternative frequencies a simulated station can send
+#define SIM_AF	8
+
+typedef struct SimStation {
+	word frequency;		//In the same units as tuneFrequency()
+	byte rssi;
+	byte snr;
+	word pi;			//RDS program identification, 0 for a station without RDS
+	char ps[9];			//RDS program service name
+	byte af[SIM_AF];	//Alternative frequencies (AF codes) sent in group 0A
+	byte afCount;
+} SimStation;
+
+class Si4735Sim
+{
+	public:
+		Si4735Sim();
+
+		/*
+		* Description:
+		*	Powers the simulated radio off, removes all stations and restores the default timing.
+		*/
+		void reset(void);
+
+		/*
+		* Description:
+		*	Adds a station to the simulated band. A station with a PI code broadcasts
+		*	the four 0A groups of its program service name, one after the other.
+		*/
+		void addStation(word frequency, byte rssi, byte snr, word pi = 0, const char * ps = 0);
+
+		/*
+		* Description:
+		*	Sets the alternative frequencies a station sends, with AF method A. Several transmitters of
+		*	one network are simulated by adding a station with the same PI code on each frequency.
+		* Parameters:
+		*	frequencies - The alternative frequencies (in 10kHz).
+		*/
+		void setAlternativeFrequencies(word frequency, const word * frequencies, byte count);
+
+		/*
+		* Description:
+		*	Changes the signal of a station, for example to simulate a car driving away from the transmitter.
+		*/
+		void setSignal(word frequency, byte rssi, byte snr);
+
+		/*
+		* Description:
+		*	Pulses the INT line if the source is enabled in GPO_IEN. The handler attached with
+		*	attachInterrupt() is called just like the external interrupt would be.
+		* Parameters:
+		*	source - The STATUS_* bit of the interrupt.
+		*/
+		void raise(byte source);
+
+		/*
+		* Description:
+		*	Advances the virtual clock.
+		*/
+		void advance(unsigned long us);
+
+		/*
+		* Description:
+		*	Replays a capture written by Si4735::startCapture() (see Si4735_Capture.h).
+		*	A capture of the bus answers every command and status read with what the radio answered
+		*	when it was recorded, the simulated band is not used. A capture of the RDS groups alone
+		*	feeds the groups to the RDS FIFO, whatever FM frequency the radio is tuned to.
+		*	The capture must stay in memory until the replay is over, reset() ends it.
+		* Parameters:
+		*	timed - Keeps the recorded timing: the virtual clock is moved forward so that no record
+		*		is used before the time it was recorded at. Otherwise each record is used as soon as the
+		*		library asks for it and the RDS groups fill the FIFO whenever there is room.
+		* Returns:
+		*	False if data is not a capture.
+		*/
+		bool replay(const byte * data, unsigned long length, bool timed);
+
+		/*
+		* Description:
+		*	Returns true until every record of the capture has been used.
+		*/
+		bool replaying(void);
+
+		//SPI slave interface, driven by digitalWrite(SS, ...) and the library's spiTransfer()
+		void select(void);
+		void deselect(void);
+		byte transfer(byte value);
+
+		//Virtual clock in microseconds
+		unsigned long now;
+
+		//Timing of the simulated radio (in us)
+		unsigned long ctsDelay;		//From the end of a command to CTS
+		unsigned long powerUpDelay;	//From POWER_UP to CTS
+		unsigned long stcDelay;		//From TUNE_FREQ to STC (per channel for SEEK_START)
+		unsigned long byteTime;		//Duration of one SPI byte
+		//Number of TUNE_FREQ commands still to come that leave the radio where it was, as a tuner that has
+		//not settled after POWER_UP does. They complete as usual, only TUNE_STATUS shows the wrong frequency.
+		byte missedTunes;
+		//Every read returns 0xFF, as it does when the GPO1 diode is missing and nothing drives MISO
+		bool floatingMiso;
+
+		//Bus counters
+		unsigned long commands;		//Commands written
+		unsigned long statusReads;	//Status (0xA0) reads
+		unsigned long responseReads;	//Long response (0xE0) reads
+		unsigned long busyWrites;		//Commands written before CTS was reported
+		unsigned long rdsGroups;		//RDS groups received by the tuner
+		unsigned long rdsOverflows;		//RDS groups lost because the FIFO was full
+		unsigned long replayMismatches;	//Commands that differ from the capture, and reads that have no recorded response
+
+		//Handler attached to the INT line
+		void (*isr)(void);
+
+		//State of the simulated radio
+		bool powered;
+		byte function;				//0 = FM, 1 = AM (SW and LW use AM)
+		word frequency;
+
+	private:
+		SimStation _stations[SIM_STATIONS];
+		byte _stationCount;
+		word _propertyAddress[SIM_PROPERTIES];
+		word _propertyValue[SIM_PROPERTIES];
+		byte _propertyCount;
+
+		bool _selected;
+		byte _control;				//First byte of the current SPI transaction
+		byte _count;				//Bytes transferred in the current SPI transaction
+		byte _frame[8];				//Command being written
+		byte _response[16];			//Response to the last command (byte 0 is the status)
+		unsigned long _ctsAt;		//Time at which CTS is reported
+		unsigned long _stcAt;		//Time at which STC is reported
+		bool _stcPending;
+		bool _stcInt;
+		bool _err;
+		bool _bandLimit;
+
+		word _rdsFifo[SIM_RDS_FIFO][4];
+		byte _rdsErrors[SIM_RDS_FIFO];	//Block error levels of each group in the FIFO
+		byte _rdsCount;
+		byte _rdsSegment;			//Next PS segment to broadcast
+		byte _rdsPair;				//Next pair of the AF list to broadcast
+		bool _rdsInt;
+		bool _rdsLost;				//A group was lost since the last FM_RDS_STATUS
+		unsigned long _rdsAt;		//Time at which the next RDS group is received
+
+		//Capture being replayed
+		const byte * _capture;
+		unsigned long _captureLength;
+		unsigned long _captureOffset;	//Next record
+		unsigned long _captureTime;		//Time of the record before it
+		byte _replaySources;		//CAPTURE_BUS or CAPTURE_GROUPS, 0 when nothing is replayed
+		bool _replayTimed;
+		unsigned long _replayStart;	//Virtual time of the start of the capture
+		byte _replayStatus;			//Status byte of the last status read or response replayed
+		word _repeatCount;			//Status reads of the CAPTURE_REPEAT record being replayed
+		word _repeatDone;
+		unsigned long _repeatFrom;	//Times of the read before the repeats and of the last repeat
+		unsigned long _repeatTo;
+
+		byte status(void);
+		void execute(void);
+		SimStation * station(word frequency);
+		void setProperty(word address, word value);
+		word getProperty(word address);
+		void receiveRDS(void);
+		void clearRDS(void);
+		word * queueRDS(byte errors);
+		void notifyRDS(void);
+
+		//Capture replay
+		unsigned long peekRecord(CaptureRecord * record);
+		void useRecord(const CaptureRecord * record, unsigned long next);
+		void skipRecords(void);
+		void waitUntil(unsigned long time);
+		byte replayStatus(void);
+		void replayResponse(void);
+		void replayCommand(void);
+		void replayGroups(void);
+};
+
+extern Si4735Sim RadioSim;
+
+#endif
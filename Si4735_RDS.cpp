@@ -0,0 +1,618 @@
+/* Arduino Si4735 Library - RDS Decoder
+ *
+ * See Si4735_RDS.h for a description of the decoder.
+*/
+#include "Si4735.h"
+
+#if defined(USE_SI4735_RDS)
+
+//Each handler is 0 unless the feature decoding its group is enabled, so the disabled decoders are not linked in
+#if defined(USE_SI4735_PTY) || defined(USE_SI4735_AF)
+	#define HANDLER_0	RDSDecoder::decodeBasic
+#else
+	#define HANDLER_0	0
+#endif
+#if defined(USE_SI4735_SLOW_LABELS)
+	#define HANDLER_1A	RDSDecoder::decodeSlowLabels
+#else
+	#define HANDLER_1A	0
+#endif
+#if defined(USE_SI4735_RADIOTEXT)
+	#define HANDLER_2	RDSDecoder::decodeRadioText
+#else
+	#define HANDLER_2	0
+#endif
+#if defined(USE_SI4735_RTPLUS)
+	#define HANDLER_3A	RDSDecoder::decodeODA
+#else
+	#define HANDLER_3A	0
+#endif
+#if defined(USE_SI4735_DATE_TIME)
+	#define HANDLER_4A	RDSDecoder::decodeTime
+#else
+	#define HANDLER_4A	0
+#endif
+#if defined(USE_SI4735_PTYN)
+	#define HANDLER_10A	RDSDecoder::decodeProgramTypeName
+#else
+	#define HANDLER_10A	0
+#endif
+#if defined(USE_SI4735_EON)
+	#define HANDLER_14A	RDSDecoder::decodeOtherNetwork
+#else
+	#define HANDLER_14A	0
+#endif
+
+const RDSGroupHandler RDSDecoder::HANDLERS[32] PROGMEM = {
+	HANDLER_0,		HANDLER_0,		//0A, 0B	Basic tuning and switching information
+	HANDLER_1A,		0,				//1A, 1B	Slow labelling codes
+	HANDLER_2,		HANDLER_2,		//2A, 2B	RadioText
+	HANDLER_3A,		0,				//3A, 3B	Open data application announcements
+	HANDLER_4A,		0,				//4A, 4B	Clock-time and date
+	0,				0,				//5A, 5B
+	0,				0,				//6A, 6B
+	0,				0,				//7A, 7B
+	0,				0,				//8A, 8B
+	0,				0,				//9A, 9B
+	HANDLER_10A,	0,				//10A, 10B	Program type name
+	0,				0,				//11A, 11B
+	0,				0,				//12A, 12B
+	0,				0,				//13A, 13B
+	HANDLER_14A,	0,				//14A, 14B	Enhanced other networks information
+	0,				0				//15A, 15B
+};
+
+RDSDecoder::RDSDecoder(){
+}
+
+void RDSDecoder::reset(RDSData * data){
+	memset(data, 0, sizeof(RDSData));
+	data->rtLength = 64;
+	data->changed = RDS_CHANGED_ALL;
+}
+
+void RDSDecoder::decode(RDSData * data, const RDSGroup * group){
+	//block[1] = Group type (15:12), version (11), TP (10), PTY (9:5) and the group specific bits (4:0)
+	byte code = group->block[1] >> 11;
+	bool version = bitRead(group->block[1], 11);
+	RDSGroupHandler handler;
+	//Version B groups repeat the PI code in block C
+	byte piBlock = (version == 0) ? 0 : 2;
+
+	//Nothing in the group can be trusted if block B could not be corrected
+	if(!weight(group, 0x02)) return;
+
+	if(data->pty != ((group->block[1] >> 5) & 31)){
+		data->pty = (group->block[1] >> 5) & 31;
+		data->changed |= RDS_CHANGED_PTY;
+	}
+	if(weight(group, 1 << piBlock) && data->pi != group->block[piBlock]){
+		data->pi = group->block[piBlock];
+		data->changed |= RDS_CHANGED_PI;
+		#if defined(USE_SI4735_CALLSIGN)
+		decodeCallSign(data, data->pi);
+		#endif
+	}
+
+	handler = (RDSGroupHandler)pgm_read_ptr(&HANDLERS[code]);
+	#if defined(USE_SI4735_RTPLUS)
+	//Open data applications use the group type announced for them in group 3A
+	if(code == data->rtPlusGroup && code) handler = decodeRTPlus;
+	#endif
+	if(handler) handler(data, group);
+}
+
+#if defined(USE_SI4735_PTY) || defined(USE_SI4735_AF)
+void RDSDecoder::decodeBasic(RDSData * data, const RDSGroup * group){
+	#if defined(USE_SI4735_PTY)
+	decodeProgramService(data, group);
+	#endif
+	#if defined(USE_SI4735_AF)
+	//Block C of version A carries two AF codes, version B repeats the PI code there
+	if(!bitRead(group->block[1], 11) && weight(group, 0x04))
+		decodeAF(data, group->block[2] >> 8, group->block[2] & 0xFF);
+	#endif
+}
+#endif
+
+#if defined(USE_SI4735_CALLSIGN)
+void RDSDecoder::decodeCallSign(RDSData * data, word pi){
+	char * csign = data->callSign;
+	//RBDS call signs: K is 4096 - 21671, W is 21672 - 39247
+	if(pi>=21672){
+		csign[0]='W';
+		pi-=21672;
+	}
+	else if(pi>=4096){
+		csign[0]='K';
+		pi-=4096;
+	}
+	else{
+		strcpy(csign, "UNKN");
+		return;
+	}
+	csign[1]=char(pi/676+65);
+	csign[2]=char((pi%676)/26+65);
+	csign[3]=char((pi%26)+65);
+	csign[4]='\0';
+}
+#endif //USE_SI4735_CALLSIGN
+
+#if defined(USE_SI4735_PTY)
+void RDSDecoder::decodeProgramService(RDSData * data, const RDSGroup * group){
+	// Groups 0A & 0B: to extract PS segment we need blocks 1 and 3
+	byte addr = group->block[1] & 3;
+	char text[2];
+	bool stable = true;
+
+	text[0] = group->block[3] >> 8;
+	text[1] = group->block[3] & 0xFF;
+	if(!vote(&data->psCandidate[addr*2], &data->psConfidence[addr], text, 2, weight(group, 0x0A)))
+		return;
+	if(printable_str(&data->programService[addr*2], &data->psCandidate[addr*2], 2))
+		data->changed |= RDS_CHANGED_PS;
+
+	for(byte i=0; i<4; i++)
+		if(data->psConfidence[i] < RDS_CONFIDENCE) stable = false;
+	//This is a simple way to indicate when the ps data has been fully refreshed.
+	if(stable && !data->psStable) data->psReady = true;
+	data->psStable = stable;
+}
+#endif //USE_SI4735_PTY
+
+#if defined(USE_SI4735_RADIOTEXT)
+void RDSDecoder::decodeRadioText(RDSData * data, const RDSGroup * group){
+	// Get their address
+	byte addressRT = group->block[1] & 15; // Get rightmost 4 bits
+	bool ab = bitRead(group->block[1], 4);
+	bool versionB = bitRead(group->block[1], 11);
+	byte size = versionB ? 2 : 4;
+	byte start = addressRT * size;
+	byte received = weight(group, versionB ? 0x0A : 0x0E);
+	byte end, length, segments;
+	word mask;
+	char text[4];
+	char previous[4];
+
+	if(!received) return;
+	//A new message starts whenever the A/B flag or the group version changes.
+	//radioText keeps showing the last complete message until the new one is complete.
+	if (ab != data->ab || versionB != data->rtVersionB) {
+		memset(data->rtConfidence, 0, sizeof(data->rtConfidence));
+		data->rtSegments = 0;
+		data->rtLength = 64;
+		data->rtStable = false;
+		data->newRadioText=1;
+	}
+	else{
+		data->newRadioText=0;
+	}
+	data->ab = ab;
+	data->rtVersionB = versionB;
+
+	if (!versionB) {
+		// Group 2A carries 4 characters in blocks C and D
+		text[0] = group->block[2] >> 8;
+		text[1] = group->block[2] & 0xFF;
+		text[2] = group->block[3] >> 8;
+		text[3] = group->block[3] & 0xFF;
+	} else {
+		// Group 2B carries 2 characters in block D
+		text[0] = group->block[3] >> 8;
+		text[1] = group->block[3] & 0xFF;
+	}
+	//Only the characters just received are made printable, the carriage return that ends the message is kept
+	for (byte i=0; i<size; i++) {
+		if (text[i] != 0x0D && (text[i] < 32 || text[i] > 126)) text[i] = ' ';
+	}
+
+	memcpy(previous, &data->rtCandidate[start], size);
+	if(vote(&data->rtCandidate[start], &data->rtConfidence[addressRT], text, size, received)){
+		//Stations sometimes change the text without toggling the A/B flag: once a segment changes,
+		//every other segment has to be received again before the message counts as complete
+		if(bitRead(data->rtSegments, addressRT) && memcmp(previous, &data->rtCandidate[start], size)){
+			data->rtSegments = 0;
+			data->rtStable = false;
+		}
+		data->rtSegments |= 1 << addressRT;
+		//The confirmed segment decides where the message ends
+		end = size;
+		for (byte i=0; i<size; i++) {
+			if (data->rtCandidate[start+i] == 0x0D) {
+				end = i;
+				break;
+			}
+		}
+		if (end < size) data->rtLength = start + end;
+		else if (data->rtLength >= start && data->rtLength < start + size) data->rtLength = 64;
+	}
+	else if(memcmp(previous, &data->rtCandidate[start], size)){
+		//A noisy reception only lowers the confidence, the segment is lost once its text is replaced
+		data->rtSegments &= ~(1 << addressRT);
+	}
+
+	//2A messages have up to 16 segments of 4 characters, 2B messages up to 16 segments of 2
+	length = (data->rtLength < 16 * size) ? data->rtLength : 16 * size;
+	segments = (length + size - 1) / size;
+	mask = (segments >= 16) ? 0xFFFF : (1 << segments) - 1;
+	if((data->rtSegments & mask) != mask){
+		data->rtStable = false;
+		return;
+	}
+	if(data->rtStable) return;
+
+	//Every segment is in: show the new message
+	data->rtStable = true;
+	memcpy(data->radioText, data->rtCandidate, length);
+	memset(&data->radioText[length], ' ', 64 - length);
+	data->radioText[64] = '\0';
+	data->rtSequence++;
+	data->changed |= RDS_CHANGED_RADIOTEXT;
+	#if defined(USE_SI4735_RTPLUS)
+	//The tags received along with the message describe it now that it is shown
+	data->rtPlusShown = true;
+	if(memcmp(&data->title, &data->titlePending, sizeof(RDSTag)) || memcmp(&data->artist, &data->artistPending, sizeof(RDSTag))){
+		data->title = data->titlePending;
+		data->artist = data->artistPending;
+		data->changed |= RDS_CHANGED_RTPLUS;
+	}
+	#endif
+}
+#endif //USE_SI4735_RADIOTEXT
+
+#if defined(USE_SI4735_DATE_TIME)
+void RDSDecoder::decodeTime(RDSData * data, const RDSGroup * group){
+	RDSTime * time = &data->time;
+	Today date;
+	//The 17 bit Modified Julian Day is split between blocks B (1:0) and C (15:1)
+	unsigned long MJD = ((unsigned long)(group->block[1] & 3) << 15) | (group->block[2] >> 1);
+	byte hour = ((group->block[2] & 1) << 4) | (group->block[3] >> 12);
+	byte minute = (group->block[3] >> 6) & 63;
+	int8_t offset = group->block[3] & 31;		//Local time offset in half hours
+	if(bitRead(group->block[3], 5)) offset = -offset;
+
+	//Every bit of the time is in blocks C and D, a corrupted time is worse than none
+	if(!weight(group, 0x0C)) return;
+	//Stations that do not set their clock send 0, dates before 2000 (MJD 51544) are not believable
+	if(MJD < 51544 || hour > 23 || minute > 59 || offset > 28 || offset < -28) return;
+
+	toDate(MJD, &date);
+	time->mjd = MJD;
+	time->year = date.year;
+	time->month = date.month;
+	time->day = date.day;
+	time->hour = hour;
+	time->minute = minute;
+	time->offset = offset;
+	time->valid = true;
+	time->sequence++;
+	data->changed |= RDS_CHANGED_TIME;
+}
+
+void RDSDecoder::toDate(unsigned long mjd, Today * date){
+	//Days since 1 March of year 0, so that the leap day is the last day of the year
+	unsigned long days = mjd + 678881;
+	unsigned long era = days / 146097;					//400 year cycles
+	unsigned long dayOfEra = days - era * 146097;
+	unsigned long yearOfEra = (dayOfEra - dayOfEra/1460 + dayOfEra/36524 - dayOfEra/146096) / 365;
+	unsigned long dayOfYear = dayOfEra - (365*yearOfEra + yearOfEra/4 - yearOfEra/100);
+	unsigned long monthIndex = (5*dayOfYear + 2) / 153;	//0 = March ... 11 = February
+	unsigned long year = yearOfEra + era * 400;
+
+	date->day = dayOfYear - (153*monthIndex + 2)/5 + 1;
+	date->month = (monthIndex < 10) ? monthIndex + 3 : monthIndex - 9;
+	if(date->month <= 2) year++;
+	date->year = year % 100;
+	date->hour = 0;
+	date->minute = 0;
+}
+
+void RDSDecoder::localTime(const RDSTime * time, Today * local){
+	//Minutes since the start of the UTC day, a full day is added so the value stays positive
+	int minutes = time->hour*60 + time->minute + time->offset*30 + 1440;
+	unsigned long mjd = time->mjd - 1 + minutes / 1440;
+
+	minutes %= 1440;
+	toDate(mjd, local);
+	local->hour = minutes / 60;
+	local->minute = minutes % 60;
+}
+#endif //USE_SI4735_DATE_TIME
+
+#if defined(USE_SI4735_SLOW_LABELS)
+void RDSDecoder::decodeSlowLabels(RDSData * data, const RDSGroup * group){
+	//Block C: linkage actuator (15), variant (14:12) and the label of the variant (11:0)
+	byte variant = (group->block[2] >> 12) & 7;
+	byte label = group->block[2] & 0xFF;
+
+	if(!weight(group, 0x04)) return;
+	if(variant == 0 && data->ecc != label){
+		data->ecc = label;
+		data->changed |= RDS_CHANGED_PI;
+	}
+	else if(variant == 3 && data->language != label){
+		data->language = label;
+		data->changed |= RDS_CHANGED_PI;
+	}
+}
+#endif //USE_SI4735_SLOW_LABELS
+
+#if defined(USE_SI4735_RTPLUS)
+void RDSDecoder::decodeODA(RDSData * data, const RDSGroup * group){
+	//Block B holds the group type code of the application, block D its application identification
+	byte code = group->block[1] & 31;
+
+	if(!weight(group, 0x0A)) return;
+	//Only version A groups are long enough for RT+ tags
+	if(group->block[3] == RDS_AID_RTPLUS && !(code & 1)) data->rtPlusGroup = code;
+}
+
+void RDSDecoder::decodeRTPlus(RDSData * data, const RDSGroup * group){
+	//Block B: item toggle (4), item running (3) and the first content type (2:0, continued in block C)
+	bool toggle = bitRead(group->block[1], 4);
+
+	if(!weight(group, 0x0E)) return;
+	if(toggle != data->rtPlusToggle){
+		//A new item: the old tags do not describe the message that is coming
+		data->rtPlusToggle = toggle;
+		data->rtPlusShown = false;
+		data->titlePending.length = 0;
+		data->artistPending.length = 0;
+	}
+	data->rtPlusRunning = bitRead(group->block[1], 3);
+	//Two tags: content type (6 bits), start (6 bits) and length - 1 (6 bits for the first, 5 for the second)
+	setTag(data, ((group->block[1] & 7) << 3) | (group->block[2] >> 13),
+		(group->block[2] >> 7) & 63, ((group->block[2] >> 1) & 63) + 1);
+	setTag(data, ((group->block[2] & 1) << 5) | (group->block[3] >> 11),
+		(group->block[3] >> 5) & 63, (group->block[3] & 31) + 1);
+}
+
+void RDSDecoder::setTag(RDSData * data, byte type, byte start, byte length){
+	RDSTag * pending;
+	RDSTag * tag;
+	if(type == RTPLUS_TITLE){
+		pending = &data->titlePending;
+		tag = &data->title;
+	}
+	else if(type == RTPLUS_ARTIST){
+		pending = &data->artistPending;
+		tag = &data->artist;
+	}
+	else return;
+	if(start + length > 64) return;
+	pending->start = start;
+	pending->length = length;
+	//Tags that keep coming once the message is complete describe radioText itself
+	if(data->rtStable && data->rtPlusShown && (tag->start != start || tag->length != length)){
+		*tag = *pending;
+		data->changed |= RDS_CHANGED_RTPLUS;
+	}
+}
+
+bool RDSDecoder::tagText(const RDSData * data, const RDSTag * tag, char * text, byte size){
+	byte length;
+	//Not even room for the terminating null
+	if(size == 0) return false;
+	length = (tag->length < size) ? tag->length : size - 1;
+	memcpy(text, &data->radioText[tag->start], length);
+	text[length] = '\0';
+	return tag->length != 0;
+}
+#endif //USE_SI4735_RTPLUS
+
+#if defined(USE_SI4735_PTYN)
+void RDSDecoder::decodeProgramTypeName(RDSData * data, const RDSGroup * group){
+	//Block B: A/B flag (4) and the segment address (0), blocks C and D hold 4 characters
+	bool ab = bitRead(group->block[1], 4);
+	byte start = (group->block[1] & 1) * 4;
+	char text[4];
+
+	if(!weight(group, 0x0E)) return;
+	if(ab != data->ptynAB){
+		//A new name, the segment that is not sent yet must not keep the old one
+		data->ptynAB = ab;
+		memset(data->ptyName, ' ', 8);
+		data->ptyName[8] = '\0';
+	}
+	text[0] = group->block[2] >> 8;
+	text[1] = group->block[2] & 0xFF;
+	text[2] = group->block[3] >> 8;
+	text[3] = group->block[3] & 0xFF;
+	if(printable_str(&data->ptyName[start], text, 4)) data->changed |= RDS_CHANGED_PTY;
+	data->ptyName[8] = '\0';
+}
+#endif //USE_SI4735_PTYN
+
+#if defined(USE_SI4735_EON)
+void RDSDecoder::decodeOtherNetwork(RDSData * data, const RDSGroup * group){
+	//Block B: variant (3:0), block C: the information of the variant, block D: PI code of the other network
+	byte variant = group->block[1] & 15;
+	word pi = group->block[3];
+	RDSOtherNetwork * other = 0;
+	char text[2];
+
+	//Variants 0 - 3 carry the program service name, two characters at a time
+	if(variant > 3 || !weight(group, 0x0E)) return;
+	for(byte i=0; i<data->otherCount; i++)
+		if(data->otherNetworks[i].pi == pi) other = &data->otherNetworks[i];
+	if(!other){
+		if(data->otherCount >= EON_SIZE) return;
+		other = &data->otherNetworks[data->otherCount++];
+		other->pi = pi;
+		memset(other->programService, ' ', 8);
+		other->programService[8] = '\0';
+	}
+	text[0] = group->block[2] >> 8;
+	text[1] = group->block[2] & 0xFF;
+	if(printable_str(&other->programService[variant*2], text, 2)) data->changed |= RDS_CHANGED_EON;
+}
+#endif //USE_SI4735_EON
+
+word RDSDecoder::afFrequency(byte code){
+	//Codes 1 - 204 are 87.6 - 107.9 MHz in 100kHz steps
+	if(code < 1 || code > 204) return 0;
+	return 8750 + code * 10;
+}
+
+#if defined(USE_SI4735_AF)
+void RDSDecoder::decodeAF(RDSData * data, byte first, byte second){
+	//224 - 249 starts a list of 0 - 25 AFs, the code after it is the first frequency
+	if(first >= 224 && first <= 249){
+		data->afHead = second;
+		addAF(data, second);
+		return;
+	}
+	//250 is followed by an LF/MF frequency, which uses the FM code values for something else
+	if(first == 250) return;
+	//Method B: every pair of the list holds the transmitter the list belongs to (the frequency
+	//sent with the list length) and one of its AFs. A pair in descending order is a regional
+	//variant, which carries a different program at times.
+	if(data->afHead && (first == data->afHead || second == data->afHead)){
+		if(first < second) addAF(data, (first == data->afHead) ? second : first);
+		return;
+	}
+	//Method A: two AFs
+	addAF(data, first);
+	addAF(data, second);
+}
+
+void RDSDecoder::addAF(RDSData * data, byte code){
+	//Filler (205), LF/MF (250) and the codes that are not used
+	if(!afFrequency(code)) return;
+	for(byte i=0; i<data->afCount; i++)
+		if(data->afCodes[i] == code) return;
+	if(data->afCount >= AF_LIST_SIZE) return;
+	data->afCodes[data->afCount++] = code;
+	data->changed |= RDS_CHANGED_AF;
+}
+#endif //USE_SI4735_AF
+
+byte RDSDecoder::weight(const RDSGroup * group, byte blocks){
+	byte worst = 0;
+	for(byte i=0; i<4; i++){
+		//BLEA is in bits 7:6 ... BLED in bits 1:0
+		byte level = (group->errors >> (6 - i*2)) & 3;
+		if(bitRead(blocks, i) && level > worst) worst = level;
+	}
+	//Level 3 means the block could not be corrected
+	return 3 - worst;
+}
+
+bool RDSDecoder::vote(char * candidate, byte * confidence, const char * text, byte length, byte weight){
+	if(!weight) return false;
+	if(*confidence && !memcmp(candidate, text, length)){
+		//Keep some headroom so that one bad reception can not replace a confirmed segment
+		*confidence = (*confidence + weight > RDS_CONFIDENCE*2) ? RDS_CONFIDENCE*2 : *confidence + weight;
+	}
+	else if(*confidence > weight){
+		*confidence -= weight;
+	}
+	else{
+		memcpy(candidate, text, length);
+		*confidence = weight;
+	}
+	return *confidence >= RDS_CONFIDENCE;
+}
+
+bool RDSDecoder::printable_str(char * str, const char * text, int length){
+	bool changed = false;
+	char c;
+	for(int i=0;i<length;i++){
+		c = ( text[i]<32 || text[i]>126 ) ? ' ' : text[i];
+		if(str[i] != c) changed = true;
+		str[i]=c;
+	}
+	return changed;
+}
+
+#if defined(USE_SI4735_STATION_CACHE)
+RDSStationCache::RDSStationCache(){
+	clear();
+}
+
+void RDSStationCache::clear(void){
+	_count = 0;
+	_hits = 0;
+	_misses = 0;
+}
+
+void RDSStationCache::getStats(CacheStats * stats){
+	stats->hits = _hits;
+	stats->misses = _misses;
+	stats->entries = _count;
+}
+
+int RDSStationCache::find(word pi, word frequency){
+	for(byte i=0; i<_count; i++){
+		if(_entries[i].pi == pi && _entries[i].frequency == frequency) return i;
+	}
+	return -1;
+}
+
+void RDSStationCache::moveToFront(int index){
+	RDSSnapshot entry = _entries[index];
+	memmove(&_entries[1], &_entries[0], index * sizeof(RDSSnapshot));
+	_entries[0] = entry;
+}
+
+void RDSStationCache::save(const RDSData * data, word frequency){
+	int index;
+	RDSSnapshot * entry;
+	bool restored;
+
+	if(!data->pi || !data->psStable) return;
+	index = find(data->pi, frequency);
+	//radioText still holds the message restore() put there if the station has not completed a new one
+	restored = (index >= 0 && _entries[index].rtValid);
+	if(index < 0){
+		//The least recently used station is the last one
+		if(_count < STATION_CACHE_SIZE) _count++;
+		index = _count - 1;
+	}
+	moveToFront(index);
+
+	entry = &_entries[0];
+	entry->pi = data->pi;
+	entry->frequency = frequency;
+	entry->pty = data->pty;
+	entry->rtValid = (data->rtSequence != 0) || restored;
+	memcpy(entry->programService, data->programService, 8);
+	memcpy(entry->radioText, data->radioText, 64);
+}
+
+bool RDSStationCache::restore(RDSData * data, word frequency){
+	int index = find(data->pi, frequency);
+	const RDSSnapshot * entry;
+
+	if(index < 0){
+		_misses++;
+		return false;
+	}
+	_hits++;
+	moveToFront(index);
+	entry = &_entries[0];
+
+	//Only the fields that differ from what the first groups have already given are reported as changed
+	if(data->pty != entry->pty){
+		data->pty = entry->pty;
+		data->changed |= RDS_CHANGED_PTY;
+	}
+	if(memcmp(data->programService, entry->programService, 8)){
+		memcpy(data->programService, entry->programService, 8);
+		data->changed |= RDS_CHANGED_PS;
+	}
+	memcpy(data->psCandidate, entry->programService, 8);
+	memset(data->psConfidence, RDS_CONFIDENCE, sizeof(data->psConfidence));
+	data->psStable = true;
+	data->psReady = true;
+
+	//The last message is shown until the one the station is sending now is complete
+	if(entry->rtValid && memcmp(data->radioText, entry->radioText, 64)){
+		memcpy(data->radioText, entry->radioText, 64);
+		data->changed |= RDS_CHANGED_RADIOTEXT;
+	}
+	return true;
+}
+#endif //USE_SI4735_STATION_CACHE
+
+#endif //USE_SI4735_RDS
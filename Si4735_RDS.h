@@ -0,0 +1,297 @@
+/* Arduino Si4735 Library - RDS Decoder
+ *
+ * The decoder turns raw RDS groups into the station information (call sign, program type,
+ * program service name, RadioText, clock time and alternative frequencies).
+ * Each group type is decoded by the handler registered for it in a table, the optional decoders
+ * (RT+, PTYN, EON and slow labelling) are only compiled in when their USE_SI4735_* option is set.
+ * The decoder does not talk to the radio: the groups can come from the Si4735, from a recording
+ * or from a test program running on a PC.
+ * It uses no dynamic memory and no floating point.
+ * Learn more about the groups in the RDS (IEC 62106) and RBDS (NRSC-4) standards.
+*/
+
+#ifndef Si4735_RDS_h
+#define Si4735_RDS_h
+
+//Bits of RDSData.changed, one per field that can be shown
+#define RDS_CHANGED_PI			0x01	//pi, callSign, ecc and language
+#define RDS_CHANGED_PTY			0x02	//pty and ptyName
+#define RDS_CHANGED_PS			0x04
+#define RDS_CHANGED_RADIOTEXT	0x08
+#define RDS_CHANGED_TIME		0x10
+#define RDS_CHANGED_AF			0x20
+#define RDS_CHANGED_RTPLUS		0x40
+#define RDS_CHANGED_EON			0x80
+#define RDS_CHANGED_ALL			0xFF
+
+//Group type code: the group type number times 2, plus 1 for version B (bits 15:11 of block B)
+#define RDS_GROUP(type, version)	((type) * 2 + (version))
+
+//Application identification of RadioText+
+#define RDS_AID_RTPLUS	0x4BD7
+//RT+ content types
+#define RTPLUS_TITLE	1
+#define RTPLUS_ARTIST	4
+
+//One RDS group as delivered by FM_RDS_STATUS
+typedef struct RDSGroup {
+	word block[4];			//Blocks A to D
+	byte errors;			//Block error levels: BLEA in bits 7:6 ... BLED in bits 1:0
+} RDSGroup;
+
+//Clock time sent in group 4A
+typedef struct RDSTime {
+	unsigned long mjd;		//Modified Julian Day of the UTC date
+	byte year;				//UTC date (2-digit year)
+	byte month;
+	byte day;
+	byte hour;				//UTC time
+	byte minute;
+	int8_t offset;			//Local time offset in half hours (-28 to +28)
+	bool valid;				//A valid clock-time group has been received since the last tune
+	byte sequence;			//Incremented for every valid clock-time group
+} RDSTime;
+
+//Position of an RT+ tagged item in the RadioText
+typedef struct RDSTag {
+	byte start;
+	byte length;				//0 if the item has not been tagged
+} RDSTag;
+
+//Program service name of another network (EON)
+typedef struct RDSOtherNetwork {
+	word pi;
+	char programService[9];
+} RDSOtherNetwork;
+
+//Information decoded from the groups of one station
+typedef struct RDSData {
+	word pi;					//Program identification
+	byte pty;					//Program type code (0 - 31)
+	char callSign[5];			//Call sign derived from the PI code (North America only)
+	char programService[9];		//Program service name
+	char radioText[65];			//The last complete RadioText message, the next one is assembled in rtCandidate
+	bool ab;					//RadioText A/B flag of the last 2A/2B group
+	bool newRadioText;			//The last RadioText group started a new message
+	bool psReady;				//The program service name has become stable
+	bool psStable;				//Every segment of programService has reached RDS_CONFIDENCE
+	bool rtStable;				//Every segment of the message being received has reached RDS_CONFIDENCE
+	byte rtSequence;			//Incremented whenever a complete message is copied to radioText
+	RDSTime time;				//Clock time from group 4A
+	byte changed;				//RDS_CHANGED_* bits of the fields updated since the bits were last cleared
+
+	//Alternative frequencies from group 0A, as AF codes (see RDSDecoder::afFrequency())
+	byte afCodes[AF_LIST_SIZE];
+	byte afCount;
+	byte afHead;				//Frequency sent with the "number of AFs" code of the list being received
+
+	//Text segments being received. A segment is copied to programService once the same characters
+	//have been received with enough confidence, the RadioText once every segment has.
+	char psCandidate[8];
+	byte psConfidence[4];		//One per 2 character segment
+	char rtCandidate[64];
+	byte rtConfidence[16];		//One per 4 (2A) or 2 (2B) character segment
+	word rtSegments;			//Bit n is set once segment n has reached RDS_CONFIDENCE, until its text is replaced
+	byte rtLength;				//Characters before the carriage return, 64 if none was received
+	bool rtVersionB;			//The RadioText is sent in 2B groups
+
+	#if defined(USE_SI4735_RTPLUS)
+	byte rtPlusGroup;			//Group type code carrying RT+, 0 until it is announced in group 3A
+	bool rtPlusToggle;			//Changes when a new item starts
+	bool rtPlusRunning;			//The tagged item is being played
+	RDSTag title;				//Tags of radioText
+	RDSTag artist;
+	RDSTag titlePending;		//Tags of the message being received, moved to title and artist when it is complete
+	RDSTag artistPending;
+	bool rtPlusShown;			//No new item has started since radioText was completed, the tags still describe it
+	#endif
+	#if defined(USE_SI4735_PTYN)
+	char ptyName[9];			//Program type name, a more specific description of the program type
+	bool ptynAB;				//A/B flag of the last 10A group
+	#endif
+	#if defined(USE_SI4735_EON)
+	RDSOtherNetwork otherNetworks[EON_SIZE];
+	byte otherCount;
+	#endif
+	#if defined(USE_SI4735_SLOW_LABELS)
+	byte ecc;					//Extended country code, 0 until received
+	byte language;				//Language code, 0 until received
+	#endif
+} RDSData;
+
+//Decodes one group type into the station information
+typedef void (*RDSGroupHandler)(RDSData * data, const RDSGroup * group);
+
+//Station information kept by RDSStationCache
+typedef struct RDSSnapshot {
+	word pi;
+	word frequency;
+	byte pty;
+	bool rtValid;				//radioText holds a complete message
+	char programService[8];
+	char radioText[64];
+} RDSSnapshot;
+
+class RDSDecoder
+{
+	public:
+		RDSDecoder();
+
+		/*
+		* Description:
+		*	Clears the station information, used when the radio is tuned to another station.
+		*	Every field is marked as changed.
+		*/
+		void reset(RDSData * data);
+
+		/*
+		* Description:
+		*	Decodes one group into the station information.
+		* Parameters:
+		*	data - The station information to update.
+		*	group - The group to decode.
+		*/
+		void decode(RDSData * data, const RDSGroup * group);
+
+		/*
+		* Description:
+		*	Converts a Modified Julian Day to a date. Only integers are used and the result
+		*	is exact for every day an RDS group can carry (1858 - 2217).
+		*/
+		#if defined(USE_SI4735_DATE_TIME)
+		static void toDate(unsigned long mjd, Today * date);
+		#endif
+
+		/*
+		* Description:
+		*	Converts the clock time to local time, carrying the offset into the date
+		*	(a UTC time shortly before midnight can be the next day locally).
+		*/
+		#if defined(USE_SI4735_DATE_TIME)
+		static void localTime(const RDSTime * time, Today * local);
+		#endif
+
+		/*
+		* Description:
+		*	Converts an AF code to an FM frequency (in 10kHz).
+		* Returns:
+		*	The frequency, or 0 if the code is not an FM frequency.
+		*/
+		static word afFrequency(byte code);
+
+		/*
+		* Description:
+		*	Copies the RadioText of an RT+ tagged item (title or artist).
+		* Parameters:
+		*	text - Receives the item, at most size - 1 characters and the terminating null.
+		* Returns:
+		*	True if the item has been tagged. False, writing nothing, if size is 0.
+		*/
+		#if defined(USE_SI4735_RTPLUS)
+		static bool tagText(const RDSData * data, const RDSTag * tag, char * text, byte size);
+		#endif
+
+	private:
+		//Handler of each group type code, 0 for the groups that are ignored (kept in program memory)
+		static const RDSGroupHandler HANDLERS[32];
+
+		#if defined(USE_SI4735_CALLSIGN)
+		static void decodeCallSign(RDSData * data, word pi);
+		#endif
+		#if defined(USE_SI4735_PTY) || defined(USE_SI4735_AF)
+		static void decodeBasic(RDSData * data, const RDSGroup * group);
+		#endif
+		#if defined(USE_SI4735_PTY)
+		static void decodeProgramService(RDSData * data, const RDSGroup * group);
+		#endif
+		#if defined(USE_SI4735_RADIOTEXT)
+		static void decodeRadioText(RDSData * data, const RDSGroup * group);
+		#endif
+		#if defined(USE_SI4735_DATE_TIME)
+		static void decodeTime(RDSData * data, const RDSGroup * group);
+		#endif
+		#if defined(USE_SI4735_AF)
+		static void decodeAF(RDSData * data, byte first, byte second);
+		static void addAF(RDSData * data, byte code);
+		#endif
+		#if defined(USE_SI4735_RTPLUS)
+		static void decodeODA(RDSData * data, const RDSGroup * group);
+		static void decodeRTPlus(RDSData * data, const RDSGroup * group);
+		static void setTag(RDSData * data, byte type, byte start, byte length);
+		#endif
+		#if defined(USE_SI4735_PTYN)
+		static void decodeProgramTypeName(RDSData * data, const RDSGroup * group);
+		#endif
+		#if defined(USE_SI4735_EON)
+		static void decodeOtherNetwork(RDSData * data, const RDSGroup * group);
+		#endif
+		#if defined(USE_SI4735_SLOW_LABELS)
+		static void decodeSlowLabels(RDSData * data, const RDSGroup * group);
+		#endif
+
+		/*
+		*  Description:
+		*	Gets the confidence a reception adds to a text segment, 0 if one of the blocks could not be corrected.
+		* Parameters:
+		*	blocks - Bit mask of the blocks holding the segment (bit 0 = block A ... bit 3 = block D).
+		*/
+		static byte weight(const RDSGroup * group, byte blocks);
+
+		/*
+		*  Description:
+		*	Votes a received text segment against the segment being assembled.
+		*	Matching text adds to the confidence, different text takes confidence away
+		*	and replaces the candidate once its confidence is used up.
+		* Returns:
+		*	True if the candidate has reached RDS_CONFIDENCE.
+		*/
+		static bool vote(char * candidate, byte * confidence, const char * text, byte length, byte weight);
+
+		/*
+		*  Description:
+		*	Copies length characters to str, converting any character that is not printable to a space.
+		* 	This helps with filtering out noisy strings.
+		*  Returns:
+		*	True if str has changed.
+		*/
+		static bool printable_str(char * str, const char * text, int length);
+};
+
+#if defined(USE_SI4735_STATION_CACHE)
+class RDSStationCache
+{
+	public:
+		RDSStationCache();
+
+		/*
+		* Description:
+		*	Remembers the station information of a station the radio is leaving. Only stations with a
+		*	stable program service name are saved, the least recently used station makes room if needed.
+		*/
+		void save(const RDSData * data, word frequency);
+
+		/*
+		* Description:
+		*	Restores the saved station information once the PI code of the tuned station is known.
+		*	The restored name counts as confirmed, it is replaced if the station sends something else.
+		*	The restored RadioText is shown until the station has sent a complete message.
+		* Returns:
+		*	True if the station was found.
+		*/
+		bool restore(RDSData * data, word frequency);
+
+		void clear(void);
+		void getStats(CacheStats * stats);
+
+	private:
+		RDSSnapshot _entries[STATION_CACHE_SIZE];		//Most recently used first
+		byte _count;
+		word _hits;
+		word _misses;
+
+		int find(word pi, word frequency);
+		void moveToFront(int index);
+};
+#endif
+
+#endif
@@ -0,0 +1,202 @@
+/* Arduino Si4735 Library - Station Index
+ *
+ * See Si4735_Stations.h for a description of the index.
+*/
+#include "Si4735.h"
+
+#if defined(USE_SI4735_STATION_INDEX)
+
+//First bytes of a saved index: 'S' and the version of the layout
+#define INDEX_MAGIC		'S'
+#define INDEX_VERSION	'1'
+
+StationIndex::StationIndex(){
+	clear();
+}
+
+void StationIndex::clear(word base, word spacing){
+	_magic[0] = INDEX_MAGIC;
+	_magic[1] = INDEX_VERSION;
+	_count = 0;
+	_base = base;
+	_spacing = spacing ? spacing : 1;
+	_check = checksum();
+}
+
+bool StationIndex::valid(void){
+	if(_magic[0] != INDEX_MAGIC || _magic[1] != INDEX_VERSION) return false;
+	if(_count > STATION_INDEX_SIZE || _spacing == 0) return false;
+	return _check == checksum();
+}
+
+bool StationIndex::add(word frequency, byte rssi, word pi, const char * name){
+	long channel = toChannel(frequency);
+	byte quality = (rssi / 4 > 15) ? 15 : rssi / 4;
+	IndexEntry entry;
+	byte position;
+	bool named = false;
+
+	if(channel < 0) return false;
+	entry.channel = channel | (quality << INDEX_QUALITY_SHIFT);
+	entry.pi = pi;
+	memset(entry.name, 0, sizeof(entry.name));
+	//A station found again replaces its entry, keeping what is only known from before
+	for(position = lowerBound(channel); position < _count && (_entries[position].channel & INDEX_CHANNEL_MASK) == channel; position++){
+		if(_entries[position].pi == pi || !_entries[position].pi || !pi){
+			if(!pi) entry.pi = _entries[position].pi;
+			memcpy(entry.name, _entries[position].name, sizeof(entry.name));
+			named = true;
+			remove(position);
+			break;
+		}
+	}
+	if(_count >= STATION_INDEX_SIZE) return false;
+	if(name) packName(entry.name, name);
+	else if(!named) packName(entry.name, "");
+
+	//On the same channel the better station comes first
+	position = lowerBound(channel);
+	while(position < _count && (_entries[position].channel & INDEX_CHANNEL_MASK) == channel
+			&& (_entries[position].channel >> INDEX_QUALITY_SHIFT) >= quality) position++;
+	memmove(&_entries[position+1], &_entries[position], (_count - position) * sizeof(IndexEntry));
+	_entries[position] = entry;
+	_count++;
+	_check = checksum();
+	return true;
+}
+
+#if defined(USE_SI4735_SCAN)
+byte StationIndex::addStations(const ScanStation * stations, byte count){
+	byte added = 0;
+	for(byte i=0; i<count; i++){
+		if(add(stations[i].frequency, stations[i].rssi, stations[i].pi)) added++;
+	}
+	return added;
+}
+#endif
+
+bool StationIndex::setName(word frequency, word pi, const char * name){
+	long channel = toChannel(frequency);
+	byte packed[6];
+	if(channel < 0) return false;
+	packName(packed, name);
+	for(byte i=lowerBound(channel); i<_count && (_entries[i].channel & INDEX_CHANNEL_MASK) == channel; i++){
+		if(_entries[i].pi != pi) continue;
+		if(!memcmp(_entries[i].name, packed, sizeof(packed))) return false;
+		memcpy(_entries[i].name, packed, sizeof(packed));
+		_check = checksum();
+		return true;
+	}
+	return false;
+}
+
+byte StationIndex::count(void){
+	return _count;
+}
+
+int StationIndex::find(word frequency){
+	long channel = toChannel(frequency);
+	byte position;
+	if(channel < 0) return -1;
+	position = lowerBound(channel);
+	if(position < _count && (_entries[position].channel & INDEX_CHANNEL_MASK) == channel) return position;
+	return -1;
+}
+
+word StationIndex::next(word frequency){
+	byte position = 0;
+	if(_count == 0) return 0;
+	//The first station on a channel above the one frequency is on (or between)
+	if(frequency >= _base && (frequency - _base) / _spacing < INDEX_CHANNEL_MASK)
+		position = lowerBound((frequency - _base) / _spacing + 1);
+	else if(frequency >= _base) position = _count;
+	if(position >= _count) position = 0;
+	return this->frequency(position);
+}
+
+word StationIndex::previous(word frequency){
+	byte position = _count;
+	if(_count == 0) return 0;
+	//The last station on a channel below frequency
+	if(frequency <= _base) position = 0;
+	else if((frequency - _base - 1) / _spacing < INDEX_CHANNEL_MASK)
+		position = lowerBound((frequency - _base - 1) / _spacing + 1);
+	if(position == 0) position = _count;
+	position--;
+	//The best station of that channel
+	return this->frequency(lowerBound(_entries[position].channel & INDEX_CHANNEL_MASK));
+}
+
+word StationIndex::frequency(byte index){
+	return _base + (_entries[index].channel & INDEX_CHANNEL_MASK) * _spacing;
+}
+
+byte StationIndex::quality(byte index){
+	return _entries[index].channel >> INDEX_QUALITY_SHIFT;
+}
+
+word StationIndex::pi(byte index){
+	return _entries[index].pi;
+}
+
+void StationIndex::getName(byte index, char * name){
+	const byte * packed = _entries[index].name;
+	for(byte i=0; i<8; i++){
+		byte bit = i * 6;
+		word bits = packed[bit / 8];
+		if(bit % 8 > 2) bits |= packed[bit / 8 + 1] << 8;
+		name[i] = ((bits >> (bit % 8)) & 0x3F) + ' ';
+	}
+	name[8] = '\0';
+}
+
+long StationIndex::toChannel(word frequency){
+	word channel;
+	if(frequency < _base) return -1;
+	channel = (frequency - _base + _spacing / 2) / _spacing;
+	return (channel > INDEX_CHANNEL_MASK) ? -1 : channel;
+}
+
+byte StationIndex::lowerBound(word channel){
+	byte low = 0;
+	byte high = _count;
+	while(low < high){
+		byte middle = (low + high) / 2;
+		if((_entries[middle].channel & INDEX_CHANNEL_MASK) < channel) low = middle + 1;
+		else high = middle;
+	}
+	return low;
+}
+
+void StationIndex::remove(byte index){
+	_count--;
+	memmove(&_entries[index], &_entries[index+1], (_count - index) * sizeof(IndexEntry));
+}
+
+byte StationIndex::checksum(void){
+	const byte * data = (const byte *)_entries;
+	word header[3] = {_count, _base, _spacing};
+	byte check = 0;
+	for(byte i=0; i<sizeof(header); i++) check = ((check << 1) | (check >> 7)) + ((const byte *)header)[i];
+	for(word i=0; i<_count * sizeof(IndexEntry); i++) check = ((check << 1) | (check >> 7)) + data[i];
+	return check;
+}
+
+//Characters from space to '_' are kept, letters in upper case, anything else becomes a space
+void StationIndex::packName(byte * packed, const char * name){
+	bool ended = false;
+	memset(packed, 0, 6);
+	for(byte i=0; i<8; i++){
+		byte code = 0;
+		byte bit = i * 6;
+		if(!name[i]) ended = true;
+		if(!ended){
+			char c = toupper(name[i]);
+			if(c >= ' ' && c <= '_') code = c - ' ';
+		}
+		packed[bit / 8] |= code << (bit % 8);
+		if(bit % 8 > 2) packed[bit / 8 + 1] |= code >> (8 - bit % 8);
+	}
+}
+
+#endif //USE_SI4735_STATION_INDEX
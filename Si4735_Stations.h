@@ -0,0 +1,131 @@
+/* Arduino Si4735 Library - Station Index
+ *
+ * The station index keeps the stations found by Si4735::findStations() so the radio can go straight
+ * to the next or previous station instead of seeking, and so the list survives a power cycle.
+ * Each station takes 10 bytes: the channel number and a quality value packed in one word, the
+ * PI code and the program service name packed in 6 bits per character (letters are kept in upper case).
+ * The stations are sorted by frequency and, on the same channel, by quality.
+ *
+ * The index is a plain block of memory without pointers. It can be written to EEPROM and read back
+ * at boot as it is (EEPROM.put(address, index) and EEPROM.get(address, index)), or copied to and
+ * from any other storage; valid() tells whether what was read back is an index.
+*/
+
+#ifndef Si4735_Stations_h
+#define Si4735_Stations_h
+
+//Channel number bits of IndexEntry.channel, the quality is kept above them
+#define INDEX_CHANNEL_MASK	0x0FFF
+#define INDEX_QUALITY_SHIFT	12
+
+typedef struct IndexEntry {
+	word channel;			//Bits 15:12 the quality (RSSI / 4, at most 15), bits 11:0 the channel number
+	word pi;				//RDS program identification, 0 if unknown
+	byte name[6];			//Program service name, 8 characters of 6 bits (0 = space ... 63 = '_')
+} IndexEntry;
+
+class StationIndex
+{
+	public:
+		//Creates an empty FM index
+		StationIndex();
+
+		/*
+		* Description:
+		*	Empties the index. The channel numbers count spacing from base, in the units of tuneFrequency(),
+		*	so the index can hold any 4096 channels: the FM default covers 64 - 108 MHz in 50 kHz channels.
+		*/
+		void clear(word base = 6400, word spacing = 5);
+
+		/*
+		* Description:
+		*	Checks an index that has been read back from storage.
+		* Returns:
+		*	True if it is a station index that has not been damaged.
+		*/
+		bool valid(void);
+
+		/*
+		* Description:
+		*	Adds a station, or updates it if the index already holds the same PI code on the same channel.
+		* Parameters:
+		*	rssi - The signal of the station (dBuV), kept as the quality.
+		*	pi - Its PI code, 0 if unknown.
+		*	name - Its program service name, 0 if unknown.
+		* Returns:
+		*	False if the frequency is not one of the index's channels or the index is full.
+		*/
+		bool add(word frequency, byte rssi, word pi = 0, const char * name = 0);
+
+		/*
+		* Description:
+		*	Adds the stations found by Si4735::findStations().
+		* Returns:
+		*	The number of stations added.
+		*/
+		#if defined(USE_SI4735_SCAN)
+		byte addStations(const ScanStation * stations, byte count);
+		#endif
+
+		/*
+		* Description:
+		*	Stores the program service name of an indexed station once it has been received.
+		* Returns:
+		*	True if the name has changed (and the index should be saved again).
+		*/
+		bool setName(word frequency, word pi, const char * name);
+
+		byte count(void);
+
+		/*
+		* Description:
+		*	Finds the best station on the channel of frequency.
+		* Returns:
+		*	Its position in the index, -1 if there is none.
+		*/
+		int find(word frequency);
+
+		/*
+		* Description:
+		*	Gets the frequency of the first station above (or below) frequency, going round at the
+		*	end of the index. Both take a binary search over the index.
+		* Returns:
+		*	The frequency to tune to, 0 if the index is empty.
+		*/
+		word next(word frequency);
+		word previous(word frequency);
+
+		//The station at a position of the index (0 to count() - 1)
+		word frequency(byte index);
+		byte quality(byte index);			//0 - 15, RSSI / 4
+		word pi(byte index);
+		void getName(byte index, char * name);	//name receives 8 characters and the terminating null
+
+	private:
+		byte _magic[2];
+		byte _count;
+		byte _check;				//Checksum of the rest of the index
+		word _base;
+		word _spacing;
+		IndexEntry _entries[STATION_INDEX_SIZE];
+
+		/*
+		*  Description:
+		*	Converts a frequency to a channel number.
+		*  Returns:
+		*	The channel number, -1 if the frequency is below the base or beyond the last channel.
+		*/
+		long toChannel(word frequency);
+
+		/*
+		*  Description:
+		*	Binary search for the first station whose channel number is at least channel.
+		*/
+		byte lowerBound(word channel);
+
+		void remove(byte index);
+		byte checksum(void);
+		static void packName(byte * packed, const char * name);
+};
+
+#endif
@@ -11,10 +11,10 @@
  * ARDUINO PIN USAGE AND PURPOSE:
  * 0 -  Serial RX (used for remote control through USB)
  * 1 -  Serial TX (used to write to the LCD display)
- * 2 -  ROTARY Encoder A (initially acts as the INT_PIN, GPO2)
- * 3 -  ROTARY Encoder B (interrupt)
+ * 2 -  RADIO INT_PIN (GPO2, tells the sketch when a seek completes or RDS data is ready)
+ * 3 -  ROTARY Encoder A (interrupt)
  * 4 -  
- * 5 -  
+ * 5 -  ROTARY Encoder B (see WIRING CHANGE below)
  * 6 -  ROTARY Push Button (Used to switch the local control mode for the rotary encoder)
  * 7 -  RADIO Slave Select
  * 8 -  RADIO Power
@@ -24,19 +24,25 @@
  * 12 - SPI MISO
  * 13 - SPI CLK
  *
+ * WIRING CHANGE:
+ * Earlier versions of this sketch had ROTARY Encoder B on pin 2. Pin 2 is now the radio's INT_PIN,
+ * so Encoder B has moved to pin 5. A board wired the old way keeps working if USE_RADIO_INT is
+ * commented out below: Encoder B then stays on pin 2 and the sketch polls the radio instead.
+ *
  * USING THE SKETCHES SERIAL INTERFACE:
  * 8 - Increase the volume
  * 2 - Decrease the volume
  * 4 - Step down to the next frequency
  * 6 - Step up to the next frequency
- * - - Seek down to the next channel
- * + - Seek up to the next channel
+ * - - Seek down to the next channel (the previous preset once presets have been found)
+ * + - Seek up to the next channel (the next preset once presets have been found)
  * m - Mute the radio
  * u - Unmute the radio
  * c - Show the callsign of the station
  * t - Show the time as reported by the station
  * s - scan the frequency band and report the SNR for each
  * q - display the receive signal quality metrics
+ * i - find the FM stations and keep them as presets (saved in the EEPROM)
  *
  * NOTES:
  * This sketch uses the Si4735 in FM mode. Other modes are AM, SW and LW. Check out the datasheet for more information on these
@@ -64,6 +70,7 @@
 //===================DEFINE LIBRARIES==================
 #include <SPI.h>
 #include <Si4735.h>
+#include <EEPROM.h>
 #include <SerLCD.h>
 #include <Rotary.h>
 //#include <Rotary_one.h>
@@ -71,13 +78,20 @@
 //===================Create the Object Instances==================
 Si4735 radio;
 Station tuned;
+StationIndex presets; //Stations found with 'i', + and - tune straight to them
 Rotary rot;
 //Rotary_one rot;
 SerLCD LCD;
 //===================DEFINE RADIO Related Parameters=================
+#define USE_RADIO_INT //Comment out to keep Encoder B on pin 2, as earlier versions of this sketch had it
 #define EncA 3 //Encoder A, this is the one that has the interrupt
-#define EncB 2//5 //Encoder B
+#if defined(USE_RADIO_INT)
+#define EncB 5 //Encoder B (pin 2 is the radio's INT_PIN)
+#else
+#define EncB 2 //Encoder B, the radio is polled from loop()
+#endif
 #define PB 6 //Pushbutton
+#define PRESETS_ADDRESS 0 //Where the presets are kept in the EEPROM
 
 //This counter variable is used to refresh the LCD screen only once.
 //This will occur when the user changes the state of the rotary encoder via the pushbutton
@@ -100,9 +114,12 @@ int state=2;
 volatile byte volume=63; //Start at 100% Volume
 //volatile byte volume=54; //Start at 85% Volume
 volatile word frequency=10030; //Start at 100.3MHz
+volatile char seek_request=0; //Seek asked for by the encoder: 1 up, -1 down. It is started from loop(), not the interrupt
 
 //RBDS INFO
 bool ps_rdy;
+bool rds_ready=false; //Set when the radio reports RDS data in its FIFO
+bool seek_done=false; //Set when the radio reports that a seek has completed
 char ps_prev[9]; //previous ps
 char pty_prev[17]="                ";
 byte mode=FM; //mode 0 is FM, mode 1 is AM
@@ -158,21 +175,19 @@ void setup()
         //Serial.println(radio.getProperty(0x1403),HEX);
         //Serial.println(radio.getProperty(0x1404),HEX);
         
-        //Try to get the radio to turn correctly to the default frequency
-        //On powerup, the system seems to have a problem with tuning.
-        //We will brute force the radio to tune to the station.        
-        radio.tuneFrequency(frequency); 
-        bool dummy;
-        int init_freq=0;
-        int max_attempts=10, attempts=1;        
-        while(init_freq!=frequency){
-          if(attempts>=max_attempts)
-            break;         
-          radio.tuneFrequency(frequency);
-          init_freq=radio.getFrequency(dummy);
-          attempts++;
-          delay(100);
-        }        
+        //Let the radio tell us when a seek has completed and when RDS data is ready
+        radio.onEvent(radioEvent);
+#if defined(USE_RADIO_INT)
+        radio.enableInterrupts(INT_STC | INT_RDS);
+#endif
+        
+        //Load the presets found last time, the EEPROM of a new board holds no valid index
+        EEPROM.get(PRESETS_ADDRESS, presets);
+        if(!presets.valid()) presets.clear();
+        
+        //Tune to the default frequency. tuneFrequency() checks where the radio landed
+        //and only tunes again if it is not the frequency asked for.
+        radio.tuneFrequency(frequency);
         
 	volume=radio.setVolume(volume);
 
@@ -194,9 +209,37 @@ void loop()
         //Process the command from the serial connection
 	remoteControl();
 
-        //Update and store the RDS information
-	ps_rdy=radio.readRDS(); 
-	radio.getRDS(&tuned);     
+#if !defined(USE_RADIO_INT)
+        //Without the INT_PIN ask the radio on every pass. The status still reports a finished seek,
+        //the RDS FIFO is simply read: readRDS() returns straight away when it is empty.
+        radio.signalInterrupt();
+        rds_ready=true;
+#endif
+        //Dispatch the events latched from the radio's INT_PIN
+        radio.processEvents();
+
+        //Update and store the RDS information once the radio has some for us
+        if(rds_ready){
+          rds_ready=false;
+	  ps_rdy=radio.readRDS(); 
+        }
+        //Only copy the RDS information when some of it has changed
+	if(radio.rdsChanges()){
+          radio.getRDS(&tuned);
+          //Keep the name of a preset once the station has sent it
+          if(tuned.psStable && presets.setName(frequency, radio.programIdentification(), tuned.programService))
+            EEPROM.put(PRESETS_ADDRESS, presets);
+        }
+
+        //Show the station that the seek landed on, processEvents() has already read it from the radio
+        if(seek_done){
+          seek_done=false;
+          TuneResult landed;
+          radio.getTuneResult(&landed);
+          frequency=landed.frequency;
+          showSEEK();
+          refresh_trigger=true;
+        }
 
         //If instructed to refresh the display, increment the counter
         if(refresh_trigger){ 
@@ -224,8 +267,6 @@ void loop()
         //-------------------LINE TWO BEHAVIOR------------------       
 	if(refresh_cnt==5){                 
 		if(state==2){ 
-                        frequency=radio.getFrequency(refresh);
-			refresh=!refresh;
                         showSEEK();                              
 		}
 	}        
@@ -246,7 +287,6 @@ void loop()
                 if(refresh_cnt>0 && refresh_cnt<=50){ //Works like a wake up function
 		        state=(state+1)%3;//Cycle through state 0, 1, and 2
                 }
-		frequency=radio.getFrequency(refresh); //Helps with getting the correct frequency to be displayed
 		refresh=true; //Give visual feedback to the user 
 	}
 
@@ -312,13 +352,15 @@ void ROTATION(void){
                   break;
                 }
 		break;
-        case 2: //Seek up and down
+        case 2: //Seek up and down, or step through the presets
                 switch(rot_state){
                 case 1: 
-                  radio.seekUp();
+                  if(usePresets()) frequency=presets.next(frequency);
+                  else seek_request=1;
                   break;
 		case -1:
-                  radio.seekDown();      
+                  if(usePresets()) frequency=presets.previous(frequency);
+                  else seek_request=-1;
                   break;
                 default:
                   break;
@@ -328,6 +370,23 @@ void ROTATION(void){
         interrupts();
 }
 
+//#####################################################################
+//                      RADIO EVENT CALLBACK FUNCTION
+//#####################################################################
+
+void radioEvent(byte event){
+        switch(event){
+        case EVENT_TUNE_COMPLETE:
+                seek_done=true;
+                break;
+        case EVENT_RDS_READY:
+                rds_ready=true;
+                break;
+        default:
+                break;
+        }
+}
+
 //#####################################################################
 //                      LCD PRINTING FUNCTIONS
 //#####################################################################
@@ -456,7 +515,7 @@ void showSEEK(){ //Displays the Seek information
 }
 //----------------------------------------------------------------------
 void showPS(){ //Displays the Program Service Information
-        if (strlen(tuned.programService) == 8){
+        if (tuned.psStable){
             if(ps_rdy){      
                 if(!strcmp(tuned.programService,ps_prev,8)){         
       		        LCD.goTo(0);     
@@ -561,13 +620,15 @@ void remoteControl(){
 			refresh=true;
 			break;
                 case '+': //Seek Up
-			radio.seekUp();
+			if(usePresets()) frequency=presets.next(frequency);
+			else radio.seekUp();
 			state=2;
 			update=true;
 			refresh=true;       
 			break;
 		case '-': //Seek Down
-			radio.seekDown();
+			if(usePresets()) frequency=presets.previous(frequency);
+			else radio.seekDown();
 			state=2;
 			update=true;
 			refresh=true; 
@@ -608,6 +669,11 @@ void remoteControl(){
                 case 's': //Sweep
 			sweep();			
 			break;
+                case 'i': //Find the presets
+			findPresets();
+			state=2;
+			refresh=true;
+			break;
                 case 'q': //Quality Check
                         showRSQ();
                 case 'v': //Show Chip Revision
@@ -628,7 +694,12 @@ void remoteControl(){
 			volume=radio.setVolume(volume);     
 			break;    
 		case 2: //Seek UP and DOWN 
-			//Seeking is done in the ROTATION function      
+			//A preset is tuned directly. The encoder's seek is started here: the radio commands wait
+			//on millis(), which does not advance inside the ROTATION interrupt.
+			if(usePresets()) radio.tuneFrequency(frequency);
+			else if(seek_request>0) radio.seekUp();
+			else if(seek_request<0) radio.seekDown();
+			seek_request=0;
 			break;
 		}
 	}
@@ -645,11 +716,8 @@ void remoteControl(){
 			refresh_trigger=true;     
 			break;    
 		case 2: //Display Seek
-			while(refresh){//Forces another refresh until frequency is valid
-				frequency=radio.getFrequency(refresh);
-				refresh=!refresh;    
-				showSEEK();
-			}   
+			//The final frequency is shown once the radio reports that the seek has completed
+			showSEEK();
 			refresh_trigger=true;
 			break;
 		}
@@ -660,17 +728,39 @@ void remoteControl(){
 
 void sweep(){
   radio.mute();
-  Metrics RSQ;
-   Serial.print("SCAN_BEGIN:");
-  for(word i=6400;i<=10800;i+=10){
-     Serial.print(i,DEC);
-     Serial.print(":");
-     radio.tuneFrequency(i); 
-     radio.getRSQ(&RSQ);
-     Serial.print(RSQ.SNR,DEC);
-     Serial.print(",");
-  }  
+  Serial.print("SCAN_BEGIN:");
+  //Each channel is measured as soon as the radio has tuned it, any key stops the sweep
+  radio.scan(6400, 10800, 10, 0, printChannel);
   Serial.print(".");
   radio.unmute();
   radio.tuneFrequency(frequency);
+}
+
+void printChannel(const ScanRecord * record){
+  Serial.print(record->frequency,DEC);
+  Serial.print(":");
+  Serial.print(record->snr,DEC);
+  Serial.print(",");
+  if(Serial.available()) radio.cancelScan();
+}
+
+//The presets only hold FM stations
+bool usePresets(){
+  return mode==FM && presets.count()>0;
+}
+
+void findPresets(){
+  ScanStation found[STATION_INDEX_SIZE];
+  if(mode!=FM) return;
+  radio.mute();
+  LCD.clearLine(2);
+  Serial.print("Finding stations");
+  //Same thresholds as the seek (RSSI 14dBuV, SNR 2dB)
+  byte count=radio.findStations(8750, 10790, 10, 14, 2, found, STATION_INDEX_SIZE);
+  presets.clear();
+  presets.addStations(found, count);
+  EEPROM.put(PRESETS_ADDRESS, presets);
+  radio.unmute();
+  if(count>0) frequency=presets.next(frequency);
+  radio.tuneFrequency(frequency);
 }
\ No newline at end of file
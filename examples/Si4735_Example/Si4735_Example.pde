@@ -37,6 +37,8 @@
 
 //Create an instance of the Si4735 named radio.
 Si4735 radio;
+//The station found by the last seek
+TuneResult landed;
 
 void setup()
 {
@@ -65,10 +67,12 @@ void loop()
       case '2':radio.volumeDown();
         break;
       //If we get the number 4, seek down to the next channel in the current bandwidth (wrap to the top when the bottom is reached).
-      case '4':radio.seekDown();
+      case '4':radio.seek(SEEK_DOWN, &landed);
+        Serial.println(landed.frequency);
         break;
       //If we get the number 6, seek up to the next channel in the current bandwidth (wrap to the bottom when the top is reached).
-      case '6':radio.seekUp();
+      case '6':radio.seek(SEEK_UP, &landed);
+        Serial.println(landed.frequency);
         break;
       //If we get the letter m, mute the radio.
       case 'M':
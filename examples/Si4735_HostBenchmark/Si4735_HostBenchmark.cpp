@@ -0,0 +1,1226 @@
+/* Si4735 Host Benchmark
+ *
+ * Times the library against the simulated radio on a PC, no Arduino or shield needed.
+ * The clock is virtual (see Si4735_Host.h), so the times are the same on every run and
+ * only depend on the simulated radio's timing, not on the speed of the PC. The RDS decoder
+ * sections are the exception: they time code that never waits on the radio, so they use
+ * the PC's processor time and only the ratios between them mean anything.
+ * Along the way it checks that the library behaves as documented, and exits with 1 if a check fails.
+ *
+ * Build and run from this folder, with the diagnostics the benchmark reads turned on:
+ *	g++ -O2 -DSI4735_HOST -DUSE_SI4735_BUS_STATS -DUSE_SI4735_RDS_STATS -DUSE_SI4735_CAPTURE \
+ *		-I../.. ../../Si4735*.cpp Si4735_HostBenchmark.cpp -o benchmark
+ *	./benchmark
+*/
+#include "Si4735.h"
+
+#if !defined(USE_SI4735_BUS_STATS) || !defined(USE_SI4735_CAPTURE)
+	#error "Build with -DUSE_SI4735_BUS_STATS and -DUSE_SI4735_CAPTURE (see the build line above)"
+#endif
+#include <time.h>
+
+Si4735 radio;
+
+word channels;
+word stations;
+word failures;
+
+//Prints the outcome of a check and counts the ones that failed
+void check(const char * name, bool passed){
+	printf("  %-48s %s\n", name, passed ? "ok" : "FAILED");
+	if(!passed) failures++;
+}
+
+//Time taken to send one channel to the PC ("10030:20," at 9600 baud)
+#define PRINT_TIME	10
+
+void countChannel(const ScanRecord * record){
+	channels++;
+	if(record->valid) stations++;
+	delay(PRINT_TIME);
+}
+
+void addStations(void){
+	RadioSim.reset();
+	RadioSim.addStation(8810, 35, 18, 0x1001, "CLASSIC ");
+	RadioSim.addStation(9310, 42, 22, 0x1002, "JAZZ 93 ");
+	RadioSim.addStation(10030, 40, 20, 0x54A8, "KROCK FM");
+	RadioSim.addStation(10570, 28, 9);
+	RadioSim.addStation(5960, 30, 12);
+	RadioSim.addStation(6070, 25, 8);
+}
+
+//The way the sweep used to be done: tune, wait a fixed 100 ms, read the signal
+unsigned long fixedDwell(word first, word last, word step){
+	Metrics rsq;
+	unsigned long start = millis();
+	for(word frequency=first; frequency<=last; frequency+=step){
+		radio.tuneFrequency(frequency);
+		delay(100);
+		radio.getRSQ(&rsq);
+		delay(PRINT_TIME);
+	}
+	return millis() - start;
+}
+
+//One tuneFrequency() and getRSQ() per channel
+unsigned long tuneEach(word first, word last, word step){
+	Metrics rsq;
+	unsigned long start = millis();
+	for(word frequency=first; frequency<=last; frequency+=step){
+		radio.tuneFrequency(frequency);
+		radio.getRSQ(&rsq);
+		delay(PRINT_TIME);
+	}
+	return millis() - start;
+}
+
+unsigned long scanBand(word first, word last, word step){
+	unsigned long start = millis();
+	channels = 0;
+	stations = 0;
+	RadioSim.statusReads = 0;
+	RadioSim.responseReads = 0;
+	radio.scan(first, last, step, 0, countChannel);
+	return millis() - start;
+}
+
+//Waiting for the PI code on every channel
+unsigned long dwellEach(word first, word last, word step){
+	unsigned long start = millis();
+	for(word frequency=first; frequency<=last; frequency+=step){
+		radio.tuneFrequency(frequency);
+		unsigned long tuned = millis();
+		while(!radio.programIdentification() && millis() - tuned < SCAN_PI_TIMEOUT){
+			delay(10);
+			radio.readRDS();
+		}
+	}
+	return millis() - start;
+}
+
+void benchmarkStations(word first, word last, word step){
+	ScanStation found[8];
+	addStations();
+	radio.begin(FM);
+	printf("FM stations %u - %u, step %u\n", first, last, step);
+	printf("  PI wait on every channel: %7lu ms\n", dwellEach(first, last, step));
+	unsigned long start = millis();
+	byte count = radio.findStations(first, last, step, 20, 3, found, 8);
+	printf("  findStations():           %7lu ms, %u stations\n", millis() - start, count);
+	for(byte i=0; i<count; i++) printf("    %5u  RSSI %2u  SNR %2u  PI %04X\n", found[i].frequency, found[i].rssi, found[i].snr, found[i].pi);
+	radio.end();
+}
+
+//Going once round the FM stations with seeks, then with the station index
+void benchmarkPresets(void){
+	ScanStation found[8];
+	StationIndex presets;
+	bool valid;
+	addStations();
+	radio.begin(FM);
+	radio.seekThresholds(3, 20);
+	byte count = radio.findStations(8750, 10790, 10, 20, 3, found, 8);
+	presets.addStations(found, count);
+	printf("FM presets, %u stations\n", count);
+	radio.tuneFrequency(8750);
+	unsigned long start = millis();
+	for(byte i=0; i<count; i++) radio.seek(SEEK_UP);
+	printf("  seek up:                  %7lu ms, %u ms per station\n", millis() - start, (unsigned)((millis() - start) / count));
+	word frequency = radio.getFrequency(valid);
+	start = millis();
+	for(byte i=0; i<count; i++){
+		frequency = presets.next(frequency);
+		radio.tuneFrequency(frequency);
+	}
+	printf("  next() + tuneFrequency(): %7lu ms, %u ms per station\n", millis() - start, (unsigned)((millis() - start) / count));
+	radio.end();
+}
+
+void benchmarkScan(char mode, const char * name, word first, word last, word step){
+	addStations();
+	radio.begin(mode);
+	printf("%s scan %u - %u, step %u (%u channels, %u ms to print each)\n", name, first, last, step, (last - first) / step + 1, PRINT_TIME);
+	printf("  fixed 100 ms dwell:      %7lu ms\n", fixedDwell(first, last, step));
+	printf("  tuneFrequency + getRSQ:  %7lu ms\n", tuneEach(first, last, step));
+	unsigned long time = scanBand(first, last, step);
+	printf("  scan():                  %7lu ms, %u channels, %u stations, %lu bus reads\n",
+		time, channels, stations, RadioSim.statusReads + RadioSim.responseReads);
+	radio.end();
+}
+
+//The sketch's old start up: tune, then tune again and read the frequency every 100 ms until it matches
+void retryLoop(word frequency){
+	bool valid;
+	word tuned = 0;
+	radio.finish(radio.startTune(frequency));
+	for(byte attempts=1; tuned != frequency && attempts < 10; attempts++){
+		radio.finish(radio.startTune(frequency));
+		tuned = radio.getFrequency(valid);
+		delay(100);
+	}
+}
+
+//From power up to audio on 100.3 MHz, with the first missed tunes landing elsewhere
+unsigned long coldBoot(bool loop, byte missedTunes, word * frequency){
+	TuneResult tuned;
+	addStations();
+	RadioSim.missedTunes = missedTunes;
+	unsigned long start = millis();
+	radio.begin(FM);
+	if(loop) retryLoop(10030);
+	else radio.tuneFrequency(10030);
+	radio.setVolume(63);
+	unsigned long time = millis() - start;
+	radio.getTuneResult(&tuned);
+	*frequency = tuned.frequency;
+	radio.end();
+	return time;
+}
+
+void benchmarkBoot(void){
+	word frequency;
+	printf("Cold boot to audio on 10030\n");
+	for(byte missed=0; missed<=1; missed++){
+		printf("  retry loop, %u missed:       %7lu ms", missed, coldBoot(true, missed, &frequency));
+		printf(", on %u\n", frequency);
+		printf("  tuneFrequency(), %u missed:  %7lu ms", missed, coldBoot(false, missed, &frequency));
+		printf(", on %u\n", frequency);
+	}
+}
+
+//The bus as the library used to drive it: 1 ms delays after chip select, every response read in full (16 bytes)
+BusStats legacyBus;
+
+void legacyCommand(byte code){
+	digitalWrite(SS, LOW);
+	delay(1);
+	RadioSim.transfer(0x48);
+	RadioSim.transfer(code);
+	for(byte i=1; i<8; i++) RadioSim.transfer(0x00);
+	digitalWrite(SS, HIGH);
+	legacyBus.transactions++;
+	legacyBus.bytesWritten += 9;
+}
+
+void legacyRead(byte length){
+	digitalWrite(SS, LOW);
+	delay(1);
+	RadioSim.transfer((length == 1) ? 0xA0 : 0xE0);
+	delay(1);
+	for(byte i=0; i<length; i++) RadioSim.transfer(0x00);
+	digitalWrite(SS, HIGH);
+	legacyBus.transactions++;
+	legacyBus.bytesWritten++;
+	legacyBus.bytesRead += length;
+}
+
+void legacyGetStatus(void){
+	legacyRead(1);
+}
+
+void legacyGetFrequency(void){
+	legacyCommand(CMD_FM_TUNE_STATUS);
+	legacyRead(16);
+}
+
+void legacyGetRSQ(void){
+	legacyCommand(CMD_FM_RSQ_STATUS);
+	legacyRead(16);
+}
+
+void libraryGetStatus(void){
+	radio.getStatus();
+}
+
+void libraryGetFrequency(void){
+	bool valid;
+	radio.getFrequency(valid);
+}
+
+void libraryGetRSQ(void){
+	Metrics rsq;
+	radio.getRSQ(&rsq);
+}
+
+//Time, bus bytes and status reads per call, averaged over 100 calls
+void timeBusCall(const char * name, void (*legacy)(void), void (*library)(void)){
+	BusStats bus;
+	unsigned long start, legacyTime, legacyStatus;
+	memset(&legacyBus, 0, sizeof(legacyBus));
+	RadioSim.statusReads = 0;
+	start = micros();
+	for(byte i=0; i<100; i++) legacy();
+	legacyTime = (micros() - start) / 100;
+	legacyStatus = RadioSim.statusReads;
+	radio.resetBusStats();
+	RadioSim.statusReads = 0;
+	start = micros();
+	for(byte i=0; i<100; i++) library();
+	radio.getBusStats(&bus);
+	printf("  %-16s %5lu us %3lu bytes %3lu status  %5lu us %3lu bytes %3lu status\n", name,
+		legacyTime, (legacyBus.bytesWritten + legacyBus.bytesRead) / 100, legacyStatus / 100,
+		(micros() - start) / 100, (bus.bytesWritten + bus.bytesRead) / 100, RadioSim.statusReads / 100);
+}
+
+void benchmarkBus(void){
+	addStations();
+	radio.begin(FM);
+	radio.tuneFrequency(10030);
+	printf("Bus cost per call: the old bus (fixed delays), then now (status reads until CTS)\n");
+	timeBusCall("getStatus():", legacyGetStatus, libraryGetStatus);
+	timeBusCall("getFrequency():", legacyGetFrequency, libraryGetFrequency);
+	timeBusCall("getRSQ():", legacyGetRSQ, libraryGetRSQ);
+	radio.end();
+}
+
+//Time from the tune to the full PS when RDS is read once per pass of an application loop taking loopTime ms.
+//One group per read is the way readRDS() used to work, done here with FM_RDS_STATUS and RDSDecoder.
+unsigned long timeToPS(word loopTime, bool drain, unsigned long * lost){
+	RDSDecoder decoder;
+	RDSData data;
+	RDSGroup group;
+	char response[16];
+	char rdsStatus[] = "2401";		//FM_RDS_STATUS with INTACK
+	const RdsResponse * rds = (const RdsResponse *)response;
+	const char * ps;
+	unsigned long start;
+	addStations();
+	radio.begin(FM);
+	radio.tuneFrequency(10030);
+	decoder.reset(&data);
+	RadioSim.rdsOverflows = 0;
+	start = millis();
+	do{
+		delay(loopTime);
+		if(drain){
+			radio.readRDS();
+			ps = radio.programService();
+		}
+		else{
+			radio.sendCommand(rdsStatus);
+			radio.getResponse(response, sizeof(RdsResponse));
+			if(rds->fifoUsed){
+				for(byte i=0; i<4; i++) group.block[i] = rds->block(i);
+				group.errors = rds->errors;
+				decoder.decode(&data, &group);
+			}
+			ps = data.programService;
+		}
+	}while(strcmp(ps, "KROCK FM") && millis() - start < 20000);
+	*lost = RadioSim.rdsOverflows;
+	radio.end();
+	return millis() - start;
+}
+
+void benchmarkRDSReads(void){
+	unsigned long lost;
+	printf("Tune to full PS, reading RDS once per application loop\n");
+	for(word loopTime=500; loopTime<=1000; loopTime+=500){
+		printf("  %4u ms loop, one group per read: %5lu ms", loopTime, timeToPS(loopTime, false, &lost));
+		printf(", %lu groups lost\n", lost);
+		printf("  %4u ms loop, readRDS():          %5lu ms", loopTime, timeToPS(loopTime, true, &lost));
+		printf(", %lu groups lost\n", lost);
+	}
+}
+
+//Runs the sketch loop (read RDS, check the signal every 100 ms) until checkFollowing() searches the alternative
+//frequencies, and returns how long the check that searched took
+unsigned long timeFollowing(bool * switched){
+	for(byte i=0; i<30; i++){
+		delay(100);
+		radio.readRDS();
+		unsigned long start = millis();
+		*switched = radio.checkFollowing();
+		//A check that only reads the RSQ takes well under a millisecond
+		if(millis() - start > 5) return millis() - start;
+	}
+	return 0;
+}
+
+//Three transmitters on the AF list of 100.3 MHz: 101.5 MHz of the same network and 98.7 MHz, which is
+//stronger but carries another PI code. The signal of 100.3 MHz and then of 101.5 MHz fades.
+void benchmarkFollowing(void){
+	word networkA[] = {9870, 10150};
+	word networkB[] = {10030, 9870};
+	bool switched, valid;
+	unsigned long time;
+	RadioSim.reset();
+	RadioSim.addStation(10030, 40, 20, 0x54A8, "KROCK FM");
+	RadioSim.addStation(10150, 45, 20, 0x54A8, "KROCK FM");
+	RadioSim.addStation(9870, 60, 20, 0x1111, "OTHER FM");
+	RadioSim.setAlternativeFrequencies(10030, networkA, 2);
+	RadioSim.setAlternativeFrequencies(10150, networkB, 2);
+	radio.begin(FM);
+	radio.tuneFrequency(10030);
+	radio.enableFollowing(25);
+	//Collect the AF list
+	for(byte i=0; i<30; i++){
+		delay(100);
+		radio.readRDS();
+		radio.checkFollowing();
+	}
+	printf("Station following, 100.3 MHz with 2 AFs, one of them another station\n");
+	RadioSim.setSignal(10030, 15, 5);
+	time = timeFollowing(&switched);
+	printf("  100.3 MHz fades:           %7lu ms, switched %s, now on %u\n", time, switched ? "yes" : "no", radio.getFrequency(valid));
+	RadioSim.setSignal(10150, 15, 5);
+	time = timeFollowing(&switched);
+	printf("  101.5 MHz fades too:       %7lu ms, switched %s, now on %u\n", time, switched ? "yes" : "no", radio.getFrequency(valid));
+	radio.end();
+}
+
+//The capture is kept in memory, as a PC reading it from the serial port would
+byte captureData[8192];
+unsigned long captureLength;
+
+void captureToMemory(const byte * data, byte length){
+	if(captureLength + length > sizeof(captureData)) return;
+	memcpy(captureData + captureLength, data, length);
+	captureLength += length;
+}
+
+//Cold boot, tune, seek and 2 s of RDS, the session that is captured and then replayed
+unsigned long captureSession(TuneResult * tuned, char * ps){
+	radio.begin(FM);
+	radio.tuneFrequency(9310);
+	radio.seek(SEEK_UP);
+	for(byte i=0; i<40; i++){
+		delay(50);
+		radio.readRDS();
+	}
+	radio.getTuneResult(tuned);
+	strcpy(ps, radio.programService());
+	radio.end();
+	return millis();
+}
+
+void benchmarkCapture(void){
+	TuneResult recorded, replayed;
+	char recordedPS[9], replayedPS[9];
+	unsigned long time, statusReads;
+	CaptureRecord record;
+	unsigned long offset = CAPTURE_HEADER_LENGTH, last = 0;
+	word records[5] = {0};
+	addStations();
+	captureLength = 0;
+	radio.startCapture(captureToMemory, CAPTURE_BUS | CAPTURE_GROUPS);
+	time = captureSession(&recorded, recordedPS);
+	radio.stopCapture();
+	statusReads = RadioSim.statusReads;
+	while((offset = captureNext(captureData, captureLength, offset, last, &record))){
+		records[record.type]++;
+		last = record.time;
+	}
+	printf("Capture of a boot, tune, seek and RDS read (%lu ms, %lu status reads, ends on %u '%s')\n",
+		time, statusReads, recorded.frequency, recordedPS);
+	printf("  %lu bytes: %u commands, %u responses, %u repeat counts, %u RDS groups\n", captureLength,
+		records[CAPTURE_COMMAND], records[CAPTURE_RESPONSE], records[CAPTURE_REPEAT], records[CAPTURE_GROUP]);
+	for(byte timed=0; timed<=1; timed++){
+		RadioSim.reset();
+		RadioSim.replay(captureData, captureLength, timed);
+		time = captureSession(&replayed, replayedPS);
+		printf("  %s replay: %lu ms, %lu mismatches\n", timed ? "timed" : "fast ", time, RadioSim.replayMismatches);
+		check(timed ? "timed replay matches the capture" : "fast replay matches the capture",
+			RadioSim.replayMismatches == 0 && !RadioSim.replaying());
+		check(timed ? "timed replay lands on the same station" : "fast replay lands on the same station",
+			replayed.frequency == recorded.frequency && !strcmp(replayedPS, recordedPS));
+	}
+}
+
+byte completedHandle;
+byte completedResult;
+byte completions;
+
+void operationDone(byte handle, byte result){
+	completedHandle = handle;
+	completedResult = result;
+	completions++;
+}
+
+//Runs the rest of the sketch (1 ms of other work) between polls until the operation completes
+word pollUntilDone(void){
+	word passes = 0;
+	while(radio.poll()){
+		delay(1);
+		passes++;
+	}
+	return passes;
+}
+
+//Tunes and seeks in the background with startTune()/startSeek() and poll()
+void benchmarkAsync(void){
+	TuneResult tuned;
+	byte handle, failed;
+	unsigned long start;
+	word passes;
+	addStations();
+	radio.begin(FM);
+	radio.onComplete(operationDone);
+	completions = 0;
+	printf("Background operations, 1 ms of other work between polls\n");
+
+	start = millis();
+	handle = radio.startTune(9310);
+	check("startTune() returns a handle", handle != 0);
+	check("a second operation is refused while busy", radio.startSeek(SEEK_UP) == 0);
+	check("getOpStatus() is BUSY while tuning", radio.getOpStatus(handle) == SI4735_BUSY);
+	passes = pollUntilDone();
+	radio.getTuneResult(&tuned);
+	printf("  tune:  %4lu ms, the loop ran %u times meanwhile\n", millis() - start, passes);
+	check("onComplete() is called once with the handle", completions == 1 && completedHandle == handle && completedResult == SI4735_OK);
+	check("getOpStatus() reports the tune's result", radio.getOpStatus(handle) == SI4735_OK && tuned.frequency == 9310);
+
+	start = millis();
+	handle = radio.startSeek(SEEK_UP);
+	passes = pollUntilDone();
+	radio.getTuneResult(&tuned);
+	printf("  seek:  %4lu ms, the loop ran %u times meanwhile, found %u\n", millis() - start, passes, tuned.frequency);
+	check("the seek completes on the next station", completions == 2 && completedHandle == handle && tuned.frequency == 10030);
+
+	//A tune the radio never completes in time
+	RadioSim.stcDelay = 1000000;
+	failed = radio.startTune(8810);
+	pollUntilDone();
+	check("a tune without STC times out", radio.getOpStatus(failed) == SI4735_TIMEOUT && completedResult == SI4735_TIMEOUT);
+	RadioSim.stcDelay = 60000;
+	handle = radio.startTune(8810);
+	pollUntilDone();
+	check("the failed handle expires once another starts", radio.getOpStatus(failed) == SI4735_EXPIRED && radio.getOpStatus(handle) == SI4735_OK);
+	radio.onComplete(0);
+	radio.end();
+}
+
+//Interrupts reaching the library and the events processEvents() dispatched for them
+void (*libraryIsr)(void);
+word interruptCount;
+word eventCount[EVENT_ERROR + 1];
+
+void countInterrupt(void){
+	interruptCount++;
+	libraryIsr();
+}
+
+void countEvent(byte event){
+	if(event <= EVENT_ERROR) eventCount[event]++;
+}
+
+//Runs the sketch loop (1 ms of other work, then processEvents()) for ms milliseconds, reading RDS after
+//each RDS event when asked to. Returns the passes that found an interrupt latched since the previous processEvents().
+word runEvents(word ms, bool readRDS, word * dispatches){
+	word latched = 0;
+	word seen = interruptCount;
+	word ready;
+	for(word i=0; i<ms; i++){
+		delay(1);
+		if(interruptCount != seen) latched++;
+		seen = interruptCount;
+		ready = eventCount[EVENT_RDS_READY];
+		if(radio.processEvents()) (*dispatches)++;
+		if(readRDS && eventCount[EVENT_RDS_READY] != ready) radio.readRDS();
+	}
+	return latched;
+}
+
+//Seeks and reads RDS with enableInterrupts(INT_STC | INT_RDS), as the Advanced Radio sketch does
+void benchmarkInterrupts(void){
+	TuneResult tuned;
+	word latched, dispatches = 0;
+	addStations();
+	radio.begin(FM);
+	radio.tuneFrequency(9310);
+	radio.onEvent(countEvent);
+	radio.enableInterrupts(INT_STC | INT_RDS);
+	libraryIsr = RadioSim.isr;
+	RadioSim.isr = countInterrupt;
+	interruptCount = 0;
+	memset(eventCount, 0, sizeof(eventCount));
+	printf("Interrupt driven events\n");
+
+	check("processEvents() does nothing without an interrupt", radio.processEvents() == 0);
+	RadioSim.raise(STATUS_RSQINT);
+	check("a source left out of GPO_IEN does not interrupt", interruptCount == 0);
+
+	//The STC of the seek. RDS is left unread: RDSINT stays set and each new group pulses INT again.
+	radio.seekUp();
+	latched = runEvents(5000, false, &dispatches);
+	radio.getTuneResult(&tuned);
+	printf("  seek: %u interrupts, %u passes dispatched, %u tune and %u RDS events\n", interruptCount, dispatches, eventCount[EVENT_TUNE_COMPLETE], eventCount[EVENT_RDS_READY]);
+	check("the seek's STC is dispatched once", eventCount[EVENT_TUNE_COMPLETE] == 1 && tuned.frequency == 10030);
+	check("one event per interrupt", eventCount[EVENT_TUNE_COMPLETE] + eventCount[EVENT_RDS_READY] == interruptCount);
+	check("every latched interrupt dispatches", latched == dispatches);
+	radio.signalInterrupt();
+	check("INTACK cleared STCINT", radio.processEvents() == 1 && eventCount[EVENT_TUNE_COMPLETE] == 1);
+
+	//Each group interrupts once the FIFO has been read and RDSINT acknowledged
+	interruptCount = 0;
+	dispatches = 0;
+	memset(eventCount, 0, sizeof(eventCount));
+	radio.readRDS();
+	latched = runEvents(2000, true, &dispatches);
+	printf("  2 s of RDS: %u interrupts, %u latched, %u passes dispatched, %u RDS events\n", interruptCount, latched, dispatches, eventCount[EVENT_RDS_READY]);
+	check("one RDS event per latched interrupt", latched > 0 && eventCount[EVENT_RDS_READY] == latched && dispatches == latched);
+	radio.readRDS();
+	radio.signalInterrupt();
+	check("INTACK cleared RDSINT", radio.processEvents() == 0);
+
+	radio.disableInterrupts();
+	check("disableInterrupts() detaches the handler", RadioSim.isr == 0);
+	radio.onEvent(0);
+	radio.end();
+}
+
+//The date conversion the decoder used before: the floating point formula from annex G of the RDS standard
+__attribute__((noinline)) void floatDate(unsigned long MJD, Today * date){
+	u_int Y = (MJD - 15078.2) / 365.25;
+	u_int M = (MJD - 14956.1 - u_int(Y*365.25)) / 30.6001;
+	byte K = (M == 14 || M == 15);
+	date->year = (Y + K) % 100;
+	date->month = M - 1 - K*12;
+	date->day = MJD - 14956 - u_int(Y*365.25) - u_int(M*30.6001);
+}
+
+__attribute__((noinline)) void integerDate(unsigned long MJD, Today * date){
+	RDSDecoder::toDate(MJD, date);
+}
+
+//Nanoseconds per call, converting the days from 2000 on. A PC has a floating point unit, the
+//AVR does not and emulates every float operation in software, so the PC flatters floatDate().
+double timeDate(void (*convert)(unsigned long, Today *)){
+	const unsigned long calls = 20000000;
+	Today date;
+	volatile byte sink = 0;
+	clock_t start = clock();
+	for(unsigned long i=0; i<calls; i++){
+		convert(51544 + (i & 65535), &date);
+		sink += date.day;
+	}
+	return (double)(clock() - start) / CLOCKS_PER_SEC / calls * 1e9;
+}
+
+void benchmarkDates(void){
+	Today a, b;
+	unsigned long days = 0, same = 0;
+	//Annex G only covers 1 March 1900 to 28 February 2100
+	for(unsigned long MJD=15079; MJD<=88127; MJD++, days++){
+		floatDate(MJD, &a);
+		integerDate(MJD, &b);
+		if(a.year == b.year && a.month == b.month && a.day == b.day) same++;
+	}
+	printf("MJD to date (PC processor time)\n");
+	printf("  floating point:           %7.1f ns\n", timeDate(floatDate));
+	printf("  integer:                  %7.1f ns\n", timeDate(integerDate));
+	printf("  same date on %lu of %lu days from 1900 to 2100\n", same, days);
+}
+
+unsigned long seed = 1;
+
+//Repeatable pseudo random numbers, so every run decodes the same groups
+word nextRandom(void){
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) & 0xFFFF;
+}
+
+//The RDS decoder as it was inside the library before RDSDecoder, kept to compare against.
+//response holds the FM_RDS_STATUS bytes. They are unsigned here: the old plain char made every
+//character above 0x7F negative on the AVR. The MJD keeps its top two bits, which the old code dropped.
+typedef struct LegacyRDS {
+	char callSign[5];
+	byte pty;
+	char ps[9];
+	char rt[65];
+	bool ab;
+	byte year;
+	byte month;
+	byte day;
+	byte hour;					//Local time
+	byte minute;
+} LegacyRDS;
+
+void legacyPrintable(char * str, int length){
+	for(int i=0; i<length; i++){
+		if((str[i] != 0 && str[i] < 32) || str[i] > 126) str[i] = ' ';
+	}
+}
+
+__attribute__((noinline)) void legacyDecode(LegacyRDS * rds, const byte * response){
+	byte type = (response[6] >> 4) & 15;
+	bool version = bitRead(response[6], 4);
+	int pi = (version == 0) ? MAKEINT(response[4], response[5]) : MAKEINT(response[8], response[9]);
+
+	rds->pty = ((response[6] & 3) << 3) | ((response[7] >> 5) & 7);
+	if(pi >= 21672){
+		rds->callSign[0] = 'W';
+		pi -= 21672;
+	}
+	else if(pi >= 4096){
+		rds->callSign[0] = 'K';
+		pi -= 4096;
+	}
+	else pi = -1;
+	if(pi >= 0){
+		rds->callSign[1] = char(pi/676 + 65);
+		rds->callSign[2] = char((pi - 676*int(pi/676))/26 + 65);
+		rds->callSign[3] = char(((pi - 676*int(pi/676))%26) + 65);
+		rds->callSign[4] = '\0';
+	}
+	else strcpy(rds->callSign, "UNKN");
+
+	if(type == 0){
+		byte addr = response[7] & 3;
+		if(response[10] != '\0') rds->ps[addr*2] = response[10];
+		if(response[11] != '\0') rds->ps[addr*2+1] = response[11];
+		legacyPrintable(rds->ps, 8);
+	}
+	else if(type == 2){
+		byte address = response[7] & 15;
+		bool ab = bitRead(response[7], 4);
+		bool cr = false;
+		byte length = 64;
+		if(version == 0){
+			for(byte i=0; i<4; i++){
+				if(response[8+i] != 0x0D) rds->rt[address*4+i] = response[8+i];
+				else{
+					length = address*4 + i;
+					cr = true;
+				}
+			}
+		}
+		else if(address <= 7){
+			if(response[10] != '\0') rds->rt[address*2] = response[10];
+			if(response[11] != '\0') rds->rt[address*2+1] = response[11];
+		}
+		if(cr){
+			for(byte i=length; i<64; i++) rds->rt[i] = ' ';
+		}
+		if(ab != rds->ab){
+			for(byte i=0; i<64; i++) rds->rt[i] = ' ';
+			rds->rt[64] = '\0';
+		}
+		rds->ab = ab;
+		legacyPrintable(rds->rt, 64);
+	}
+	else if(type == 4 && version == 0){
+		unsigned long MJD = ((unsigned long)(response[7] & 3) << 15) | ((u_int)response[8] << 7) | ((response[9] >> 1) & 127);
+		int8_t offset = response[11] & 31;
+		byte hour = ((response[9] & 1) << 4) | ((response[10] >> 4) & 15);
+		byte minute = ((response[10] & 15) << 2) | ((response[11] >> 6) & 3);
+		Today date;
+		if(bitRead(response[11], 5)) offset = -offset;
+		floatDate(MJD, &date);
+		rds->year = date.year;
+		rds->month = date.month;
+		rds->day = date.day;
+		rds->hour = (hour + offset/2 + 24) % 24;
+		rds->minute = (minute + (offset%2)*30 + 60) % 60;
+	}
+}
+
+//The FM_RDS_STATUS bytes that carry a group
+void toResponse(const RDSGroup * group, byte * response){
+	memset(response, 0, 4);
+	for(byte i=0; i<4; i++){
+		response[4 + i*2] = group->block[i] >> 8;
+		response[5 + i*2] = group->block[i] & 0xFF;
+	}
+}
+
+void decodeBoth(RDSDecoder * decoder, RDSData * data, LegacyRDS * legacy, const RDSGroup * group){
+	byte response[12];
+	toResponse(group, response);
+	decoder->decode(data, group);
+	legacyDecode(legacy, response);
+}
+
+//A clean version A group of type 0, 2 or 4 with 7-bit data, the groups both decoders read the same way
+void randomGroup(RDSGroup * group, byte type){
+	for(byte i=0; i<4; i++) group->block[i] = nextRandom() & 0x7F7F;
+	group->block[1] = (group->block[1] & 0x07FF) | ((word)type << 12);
+	group->errors = 0;
+}
+
+//Sends a text segment by segment, flags holds the rest of block B. The PS has 2 characters per group
+//in block D, RadioText 2A has 4 in blocks C and D (twoBlocks).
+void sendText(RDSDecoder * decoder, RDSData * data, LegacyRDS * legacy, word pi, word flags, const char * text, byte segments, bool twoBlocks){
+	RDSGroup group;
+	group.errors = 0;
+	for(byte addr=0; addr<segments; addr++){
+		const char * segment = &text[addr * (twoBlocks ? 4 : 2)];
+		group.block[0] = pi;
+		group.block[1] = flags | addr;
+		group.block[2] = twoBlocks ? MAKEINT(segment[0], segment[1]) : (nextRandom() & 0x7F7F);
+		group.block[3] = twoBlocks ? MAKEINT(segment[2], segment[3]) : MAKEINT(segment[0], segment[1]);
+		decodeBoth(decoder, data, legacy, &group);
+	}
+}
+
+unsigned long sameCallSign(unsigned long groups){
+	RDSDecoder decoder;
+	RDSData data;
+	LegacyRDS legacy;
+	RDSGroup group;
+	unsigned long same = 0;
+	decoder.reset(&data);
+	memset(&legacy, 0, sizeof(legacy));
+	for(unsigned long i=0; i<groups; i++){
+		randomGroup(&group, (i % 3) * 2);
+		decodeBoth(&decoder, &data, &legacy, &group);
+		if(!strcmp(legacy.callSign, data.callSign) && legacy.pty == data.pty) same++;
+	}
+	return same;
+}
+
+//Each station sends its PS once and a RadioText, ended by a carriage return when it is shorter than 64
+//characters. The old decoder blanked the first segment of a new message, so the RadioText is sent twice.
+unsigned long sameText(unsigned long stations){
+	RDSDecoder decoder;
+	RDSData data;
+	LegacyRDS legacy;
+	char ps[8];
+	char rt[64];
+	unsigned long same = 0;
+	for(unsigned long station=0; station<stations; station++){
+		word pi = 4096 + nextRandom() % 35152;
+		byte length = 1 + nextRandom() % 64;
+		word flags = RDS_GROUP(2, 0) << 11 | (station & 1) << 4;
+		decoder.reset(&data);
+		memset(&legacy, 0, sizeof(legacy));
+		for(byte i=0; i<8; i++) ps[i] = 32 + nextRandom() % 95;
+		for(byte i=0; i<64; i++) rt[i] = (i < length) ? 32 + nextRandom() % 95 : ' ';
+		if(length < 64) rt[length] = 0x0D;
+		sendText(&decoder, &data, &legacy, pi, RDS_GROUP(0, 0) << 11, ps, 4, false);
+		for(byte pass=0; pass<2; pass++) sendText(&decoder, &data, &legacy, pi, flags, rt, (length < 64) ? length/4 + 1 : 16, true);
+		if(!strcmp(legacy.ps, data.programService) && !strncmp(legacy.rt, data.radioText, 64)) same++;
+	}
+	return same;
+}
+
+//Clock times from 2000 (the new decoder rejects earlier dates) to 2100, with whole hour offsets:
+//the old decoder did not carry a half hour offset into the hour
+unsigned long sameTime(unsigned long groups){
+	RDSDecoder decoder;
+	RDSData data;
+	LegacyRDS legacy;
+	RDSGroup group;
+	Today local;
+	unsigned long same = 0;
+	decoder.reset(&data);
+	memset(&legacy, 0, sizeof(legacy));
+	group.block[0] = 0x54A8;
+	group.errors = 0;
+	for(unsigned long i=0; i<groups; i++){
+		unsigned long MJD = 51544 + nextRandom() % (88127 - 51544 + 1);
+		byte hour = nextRandom() % 24;
+		byte minute = nextRandom() % 60;
+		int8_t offset = (int8_t)(nextRandom() % 29) * 2 - 28;
+		group.block[1] = RDS_GROUP(4, 0) << 11 | ((MJD >> 15) & 3);
+		group.block[2] = ((MJD & 0x7FFF) << 1) | (hour >> 4);
+		group.block[3] = ((word)(hour & 15) << 12) | (minute << 6) | ((offset < 0) ? 0x20 | -offset : offset);
+		decodeBoth(&decoder, &data, &legacy, &group);
+		RDSDecoder::localTime(&data.time, &local);
+		if(legacy.year == data.time.year && legacy.month == data.time.month && legacy.day == data.time.day
+				&& legacy.hour == local.hour && legacy.minute == local.minute) same++;
+	}
+	return same;
+}
+
+//Groups decoded per second (millions)
+double decodeRate(bool legacy){
+	const unsigned long groups = 10000000;
+	static RDSGroup group[4096];
+	static byte response[4096][12];
+	RDSDecoder decoder;
+	RDSData data;
+	LegacyRDS old;
+	seed = 1;
+	for(word i=0; i<4096; i++){
+		randomGroup(&group[i], (i % 3) * 2);
+		toResponse(&group[i], response[i]);
+	}
+	decoder.reset(&data);
+	memset(&old, 0, sizeof(old));
+	clock_t start = clock();
+	for(unsigned long i=0; i<groups; i++){
+		if(legacy) legacyDecode(&old, response[i & 4095]);
+		else decoder.decode(&data, &group[i & 4095]);
+	}
+	return groups / ((double)(clock() - start) / CLOCKS_PER_SEC) / 1e6;
+}
+
+void benchmarkDecoder(void){
+	printf("RDS decoder, groups 0A, 2A and 4A (PC processor time)\n");
+	printf("  old decoder:              %7.1f million groups/s\n", decodeRate(true));
+	printf("  RDSDecoder:               %7.1f million groups/s\n", decodeRate(false));
+	seed = 1;
+	printf("  same call sign and PTY:   %lu of %u groups\n", sameCallSign(100000), 100000);
+	printf("  same PS and RadioText:    %lu of %u stations\n", sameText(10000), 10000);
+	printf("  same date and local time: %lu of %u groups\n", sameTime(100000), 100000);
+}
+
+//Tunes to a station sending "RADIO 1 " and decodes 200 0A groups each time. A block is received clean 55% of
+//the time, with 1-2 bits corrected 20%, 3-5 bits 15% and uncorrectable 10%. The higher the error level,
+//the more likely a character or the segment address is still wrong: 1%, 10%, 35% and 80%.
+void noisyPS(const char * name, bool legacyDecoder){
+	const char * ps = "RADIO 1 ";
+	const byte wrong[4] = {1, 10, 35, 80};
+	const word tunes = 2000;
+	RDSDecoder decoder;
+	RDSData data;
+	LegacyRDS legacy;
+	RDSGroup group;
+	byte response[12];
+	unsigned long groupsSum = 0, changes = 0, garbage = 0;
+	word never = 0;
+	seed = 7;
+	for(word tune=0; tune<tunes; tune++){
+		char shown[9] = "";
+		int first = -1;
+		decoder.reset(&data);
+		memset(&legacy, 0, sizeof(legacy));
+		for(byte g=0; g<200; g++){
+			byte segment = g & 3;
+			byte level[4];
+			char text[2];
+			const char * now;
+			for(byte b=0; b<4; b++){
+				byte x = nextRandom() % 100;
+				level[b] = (x < 55) ? 0 : (x < 75) ? 1 : (x < 90) ? 2 : 3;
+			}
+			text[0] = ps[segment*2];
+			text[1] = ps[segment*2+1];
+			for(byte i=0; i<2; i++){
+				if(nextRandom() % 100 < wrong[level[3]]) text[i] ^= 1 << (nextRandom() % 7);
+			}
+			if(nextRandom() % 100 < wrong[level[1]]) segment ^= 1 << (nextRandom() % 2);
+			group.block[0] = 0x1234;
+			group.block[1] = RDS_GROUP(0, 0) << 11 | segment;
+			group.block[2] = 0x1234;
+			group.block[3] = MAKEINT((byte)text[0], (byte)text[1]);
+			group.errors = (level[0] << 6) | (level[1] << 4) | (level[2] << 2) | level[3];
+			if(legacyDecoder){
+				toResponse(&group, response);
+				legacyDecode(&legacy, response);
+				now = legacy.ps;
+			}
+			else{
+				decoder.decode(&data, &group);
+				now = data.programService;
+			}
+			//Every time the full name shown changes is a re-render on the display
+			if(strlen(now) == 8 && strcmp(now, shown)){
+				changes++;
+				strcpy(shown, now);
+				if(strcmp(shown, ps)) garbage++;
+			}
+			if(first < 0 && !strcmp(now, ps)) first = g;
+		}
+		if(first < 0) never++;
+		else groupsSum += first + 1;
+	}
+	printf("  %s %5.1f groups to the PS, %5.1f changes shown (%5.1f garbage), never on %u tunes\n", name,
+		(double)groupsSum / (tunes - never), (double)changes / tunes, (double)garbage / tunes, never);
+}
+
+//The same noise on a station sending a 28 character RadioText in 2A groups, 300 groups each time.
+//A display redraws the text whenever it changes, with the old decoder that is also while it fills.
+void noisyRadioText(const char * name, bool legacyDecoder){
+	const char * rt = "NOW PLAYING: MORNING SHOW\r  ";
+	const byte wrong[4] = {1, 10, 35, 80};
+	const word tunes = 1000;
+	RDSDecoder decoder;
+	RDSData data;
+	LegacyRDS legacy;
+	RDSGroup group;
+	byte response[12];
+	char expected[65];
+	unsigned long groupsSum = 0, changes = 0, garbage = 0;
+	word never = 0;
+	memset(expected, ' ', 64);
+	memcpy(expected, rt, 25);
+	expected[64] = '\0';
+	seed = 11;
+	for(word tune=0; tune<tunes; tune++){
+		char shown[65] = "";
+		int first = -1;
+		decoder.reset(&data);
+		memset(&legacy, 0, sizeof(legacy));
+		for(word g=0; g<300; g++){
+			byte segment = g % 7;
+			byte level[4];
+			char text[4];
+			const char * now;
+			for(byte b=0; b<4; b++){
+				byte x = nextRandom() % 100;
+				level[b] = (x < 55) ? 0 : (x < 75) ? 1 : (x < 90) ? 2 : 3;
+			}
+			memcpy(text, &rt[segment*4], 4);
+			for(byte i=0; i<4; i++){
+				if(nextRandom() % 100 < wrong[level[2 + i/2]]) text[i] ^= 1 << (nextRandom() % 7);
+			}
+			if(nextRandom() % 100 < wrong[level[1]]) segment ^= 1 << (nextRandom() % 4);
+			group.block[0] = 0x1234;
+			group.block[1] = RDS_GROUP(2, 0) << 11 | segment;
+			group.block[2] = MAKEINT((byte)text[0], (byte)text[1]);
+			group.block[3] = MAKEINT((byte)text[2], (byte)text[3]);
+			group.errors = (level[0] << 6) | (level[1] << 4) | (level[2] << 2) | level[3];
+			if(legacyDecoder){
+				toResponse(&group, response);
+				legacyDecode(&legacy, response);
+				now = legacy.rt;
+			}
+			else{
+				decoder.decode(&data, &group);
+				now = data.radioText;
+			}
+			if(now[0] && strcmp(now, shown)){
+				changes++;
+				strcpy(shown, now);
+				if(strcmp(shown, expected)) garbage++;
+			}
+			if(first < 0 && !strcmp(now, expected)) first = g;
+		}
+		if(first < 0) never++;
+		else groupsSum += first + 1;
+	}
+	printf("  %s %5.1f groups to the text, %5.1f changes shown (%5.1f garbage), never on %u tunes\n", name,
+		(double)groupsSum / (tunes - never), (double)changes / tunes, (double)garbage / tunes, never);
+}
+
+void benchmarkNoise(void){
+	printf("PS on a noisy station, 2000 tunes of 200 groups, 45%% of the blocks corrected or lost\n");
+	noisyPS("old decoder:", true);
+	noisyPS("RDSDecoder: ", false);
+	printf("RadioText on the same station, 1000 tunes of 300 2A groups\n");
+	noisyRadioText("old decoder:", true);
+	noisyRadioText("RDSDecoder: ", false);
+}
+
+//Decodes one clean group, which weighs as much as RDS_CONFIDENCE on its own
+void sendGroup(RDSDecoder * decoder, RDSData * data, word b, word c, word d){
+	RDSGroup group;
+	group.block[0] = 0x1234;
+	group.block[1] = b;
+	group.block[2] = c;
+	group.block[3] = d;
+	group.errors = 0;
+	decoder->decode(data, &group);
+}
+
+//An RT+ group (11A here) with the item toggle and running bits and two tags
+void sendTags(RDSDecoder * decoder, RDSData * data, bool toggle, byte type1, byte start1, byte length1, byte type2, byte start2, byte length2){
+	sendGroup(decoder, data, (RDS_GROUP(11, 0) << 11) | (toggle << 4) | (1 << 3) | ((type1 >> 3) & 7),
+		((type1 & 7) << 13) | (start1 << 7) | ((length1 - 1) << 1) | ((type2 >> 5) & 1),
+		((type2 & 31) << 11) | (start2 << 5) | (length2 - 1));
+}
+
+//Crafted groups for the features the random groups do not reach: RT+ (3A and the group it announces),
+//the program type name (10A), other networks (14A) and the extended country code and language (1A)
+void benchmarkGroups(void){
+	RDSDecoder decoder;
+	RDSData data;
+	const char * text = "Queen - Bohemian Rhapsody\r  ";
+	char item[20];
+	printf("RDS decoder, crafted groups\n");
+
+	decoder.reset(&data);
+	sendGroup(&decoder, &data, (RDS_GROUP(3, 0) << 11) | RDS_GROUP(11, 0), 0, RDS_AID_RTPLUS);
+	check("3A announces RT+ in group 11A", data.rtPlusGroup == RDS_GROUP(11, 0));
+	sendTags(&decoder, &data, false, RTPLUS_TITLE, 8, 17, RTPLUS_ARTIST, 0, 5);
+	for(byte addr=0; addr<7; addr++)
+		sendGroup(&decoder, &data, (RDS_GROUP(2, 0) << 11) | addr, MAKEINT(text[addr*4], text[addr*4+1]), MAKEINT(text[addr*4+2], text[addr*4+3]));
+	check("the RadioText is complete", data.rtStable && !strncmp(data.radioText, "Queen - Bohemian Rhapsody ", 26));
+	check("RT+ tags the title", RDSDecoder::tagText(&data, &data.title, item, sizeof(item)) && !strcmp(item, "Bohemian Rhapsody"));
+	check("RT+ tags the artist", RDSDecoder::tagText(&data, &data.artist, item, sizeof(item)) && !strcmp(item, "Queen"));
+	check("tagText() cuts the item to size", RDSDecoder::tagText(&data, &data.title, item, 9) && !strcmp(item, "Bohemian"));
+	item[0] = 'x';
+	check("tagText() writes nothing when size is 0", !RDSDecoder::tagText(&data, &data.title, item, 0) && item[0] == 'x');
+	//A new item: its tags wait for the message they describe
+	sendTags(&decoder, &data, true, RTPLUS_TITLE, 0, 4, RTPLUS_ARTIST, 5, 3);
+	check("a new item keeps the tags of the text shown", data.title.start == 8 && data.title.length == 17);
+
+	decoder.reset(&data);
+	sendGroup(&decoder, &data, RDS_GROUP(10, 0) << 11, MAKEINT('F', 'o'), MAKEINT('o', 't'));
+	sendGroup(&decoder, &data, (RDS_GROUP(10, 0) << 11) | 1, MAKEINT('b', 'a'), MAKEINT('l', 'l'));
+	check("10A sends the program type name", !strcmp(data.ptyName, "Football"));
+	sendGroup(&decoder, &data, (RDS_GROUP(10, 0) << 11) | (1 << 4), MAKEINT('J', 'a'), MAKEINT('z', 'z'));
+	check("the A/B flag clears the old name", !strcmp(data.ptyName, "Jazz    "));
+
+	decoder.reset(&data);
+	for(byte variant=0; variant<4; variant++)
+		sendGroup(&decoder, &data, (RDS_GROUP(14, 0) << 11) | variant, MAKEINT("RADIO 4 "[variant*2], "RADIO 4 "[variant*2+1]), 0x5302);
+	sendGroup(&decoder, &data, (RDS_GROUP(14, 0) << 11) | 4, 0x1234, 0x5303);
+	check("14A sends the PS of another network", data.otherCount == 1 && data.otherNetworks[0].pi == 0x5302 && !strcmp(data.otherNetworks[0].programService, "RADIO 4 "));
+
+	decoder.reset(&data);
+	sendGroup(&decoder, &data, RDS_GROUP(1, 0) << 11, (0 << 12) | 0xE1, 0);
+	sendGroup(&decoder, &data, RDS_GROUP(1, 0) << 11, (3 << 12) | 0x09, 0);
+	check("1A sends the extended country code and language", data.ecc == 0xE1 && data.language == 0x09);
+}
+
+//Reads RDS every 10 ms until the program service name is stable (a seek across the band takes a few seconds),
+//returns how long it took
+unsigned long timeToStablePS(Station * station){
+	unsigned long start = millis();
+	do{
+		delay(10);
+		radio.readRDS();
+		radio.getRDS(station);
+	}while(!station->psStable && millis() - start < 10000);
+	return millis() - start;
+}
+
+//Tunes and reports whether the station cache knew the station
+bool cachedTune(word frequency, Station * station, unsigned long * ms){
+	CacheStats before, after;
+	radio.getStationCacheStats(&before);
+	radio.tuneFrequency(frequency);
+	*ms = timeToStablePS(station);
+	radio.getStationCacheStats(&after);
+	return after.hits > before.hits;
+}
+
+//Going between the stations with room for two of them in the cache, then the cache on its own with a RadioText
+void benchmarkCache(void){
+	Station station;
+	CacheStats stats;
+	unsigned long ms, missed;
+	bool hit;
+	RDSStationCache cache;
+	RDSDecoder decoder;
+	RDSData data;
+	const char * rt = "NOW PLAYING: MORNING SHOW\r  ";
+	printf("Station cache (%u stations)\n", STATION_CACHE_SIZE);
+
+	addStations();
+	radio.begin(FM);
+	radio.clearStationCache();
+	check("a first visit misses", !cachedTune(8810, &station, &missed));
+	cachedTune(9310, &station, &ms);
+	hit = cachedTune(8810, &station, &ms);
+	printf("  PS stable after %lu ms on a miss, %lu ms on a hit\n", missed, ms);
+	check("a return hits and shows the PS after the first group", hit && ms < 100 && !strcmp(station.programService, "CLASSIC "));
+	cachedTune(10030, &station, &ms);
+	check("the least recently used station is evicted", !cachedTune(9310, &station, &ms));
+	radio.getStationCacheStats(&stats);
+	check("two stations are kept", stats.entries == 2);
+
+	//A seek nobody reads back: the station is still saved and restored under the frequency it landed on
+	radio.seekUp();
+	ms = timeToStablePS(&station);
+	radio.getStationCacheStats(&stats);
+	check("seekUp() restores the station it lands on", stats.hits == 2 && !strcmp(station.programService, "KROCK FM"));
+	radio.seekDown();
+	timeToStablePS(&station);
+	check("seekDown() saves the station it leaves under its frequency", cachedTune(10030, &station, &ms));
+	radio.end();
+
+	//A RadioText restored from the cache stays valid until the station completes a new one
+	decoder.reset(&data);
+	for(byte addr=0; addr<4; addr++)
+		sendGroup(&decoder, &data, addr, 0, MAKEINT("CLASSIC "[addr*2], "CLASSIC "[addr*2+1]));
+	for(byte addr=0; addr<7; addr++)
+		sendGroup(&decoder, &data, (RDS_GROUP(2, 0) << 11) | addr, MAKEINT(rt[addr*4], rt[addr*4+1]), MAKEINT(rt[addr*4+2], rt[addr*4+3]));
+	cache.save(&data, 8810);
+	for(byte visit=0; visit<2; visit++){
+		decoder.reset(&data);
+		sendGroup(&decoder, &data, 0, 0, MAKEINT('C', 'L'));
+		cache.restore(&data, 8810);
+		cache.save(&data, 8810);
+	}
+	check("a restored RadioText is saved again", !strncmp(data.radioText, "NOW PLAYING: MORNING SHOW ", 26));
+}
+
+//The RDS_CHANGED_* bits set by one clean group
+byte changesFrom(RDSDecoder * decoder, RDSData * data, word pi, word b, word c, word d){
+	RDSGroup group;
+	group.block[0] = pi;
+	group.block[1] = b;
+	group.block[2] = c;
+	group.block[3] = d;
+	group.errors = 0;
+	data->changed = 0;
+	decoder->decode(data, &group);
+	return data->changed;
+}
+
+//Each group changes one field, then comes again and must change nothing
+void benchmarkChanges(void){
+	RDSDecoder decoder;
+	RDSData data;
+	const char * rt = "NOW PLAYING: MORNING SHOW\r  ";
+	const word pty = 5 << 5;
+	const word filler = MAKEINT(205, 205);
+	const word ps = MAKEINT('C', 'L');
+	byte changes[7];
+	Station station;
+	printf("RDS_CHANGED_* bits\n");
+
+	decoder.reset(&data);
+	check("reset() sets every bit", data.changed == RDS_CHANGED_ALL);
+	check("PI and PS of the first group", changesFrom(&decoder, &data, 0x1234, 0, filler, ps) == (RDS_CHANGED_PI | RDS_CHANGED_PS));
+	check("nothing when it comes again", changesFrom(&decoder, &data, 0x1234, 0, filler, ps) == 0);
+	check("PTY", changesFrom(&decoder, &data, 0x1234, pty, filler, ps) == RDS_CHANGED_PTY);
+	check("AF", changesFrom(&decoder, &data, 0x1234, pty, MAKEINT(226, 10), ps) == RDS_CHANGED_AF);
+	check("nothing for an AF already known", changesFrom(&decoder, &data, 0x1234, pty, MAKEINT(226, 10), ps) == 0);
+	check("PS", changesFrom(&decoder, &data, 0x1234, pty | 1, filler, MAKEINT('A', 'S')) == RDS_CHANGED_PS);
+	check("PI", changesFrom(&decoder, &data, 0x1235, pty | 1, filler, MAKEINT('A', 'S')) == RDS_CHANGED_PI);
+
+	//RT+ tags sent with the message change nothing until it is complete
+	check("nothing for the RT+ announcement", changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(3, 0) << 11) | pty | RDS_GROUP(11, 0), 0, RDS_AID_RTPLUS) == 0);
+	check("nothing for the tags of a message being received", changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(11, 0) << 11) | pty | (1 << 3), (RTPLUS_TITLE << 13) | (13 << 7) | (11 << 1), (RTPLUS_ARTIST << 11) | 0) == 0);
+	for(byte addr=0; addr<7; addr++)
+		changes[addr] = changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(2, 0) << 11) | pty | addr, MAKEINT(rt[addr*4], rt[addr*4+1]), MAKEINT(rt[addr*4+2], rt[addr*4+3]));
+	check("nothing while the RadioText is received", !changes[0] && !changes[1] && !changes[2] && !changes[3] && !changes[4] && !changes[5]);
+	check("RADIOTEXT and RTPLUS once it is complete", changes[6] == (RDS_CHANGED_RADIOTEXT | RDS_CHANGED_RTPLUS));
+	check("nothing for the same tags", changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(11, 0) << 11) | pty | (1 << 3), (RTPLUS_TITLE << 13) | (13 << 7) | (11 << 1), (RTPLUS_ARTIST << 11) | 0) == 0);
+	check("RTPLUS for new tags of the message shown", changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(11, 0) << 11) | pty | (1 << 3), (RTPLUS_TITLE << 13) | (13 << 7) | (6 << 1), (RTPLUS_ARTIST << 11) | 0) == RDS_CHANGED_RTPLUS);
+	//4A: 1 January 2024 (MJD 60310), 12:30 UTC
+	check("TIME for every clock-time group", changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(4, 0) << 11) | pty | (60310 >> 15), (word)(60310 << 1) | (12 >> 4), ((12 & 15) << 12) | (30 << 6)) == RDS_CHANGED_TIME);
+	check("PTY for the program type name", changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(10, 0) << 11) | pty, MAKEINT('J', 'a'), MAKEINT('z', 'z')) == RDS_CHANGED_PTY);
+	check("nothing for the same name", changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(10, 0) << 11) | pty, MAKEINT('J', 'a'), MAKEINT('z', 'z')) == 0);
+	check("EON", changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(14, 0) << 11) | pty, MAKEINT('R', 'A'), 0x5302) == RDS_CHANGED_EON);
+	check("nothing for the same EON name", changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(14, 0) << 11) | pty, MAKEINT('R', 'A'), 0x5302) == 0);
+	check("PI for the extended country code", changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(1, 0) << 11) | pty, 0xE1, 0) == RDS_CHANGED_PI);
+	check("nothing for the same code", changesFrom(&decoder, &data, 0x1235, (RDS_GROUP(1, 0) << 11) | pty, 0xE1, 0) == 0);
+
+	//rdsChanges() hands the bits over once. The second visit is restored from the station cache.
+	addStations();
+	radio.begin(FM);
+	radio.clearStationCache();
+	for(byte visit=0; visit<2; visit++){
+		radio.tuneFrequency(8810);
+		timeToStablePS(&station);
+		radio.tuneFrequency(9310);
+		check(visit ? "rdsChanges() reports every bit after a tune back" : "rdsChanges() reports every bit after a tune", radio.rdsChanges() == RDS_CHANGED_ALL);
+		check("and clears them", radio.rdsChanges() == 0);
+		timeToStablePS(&station);
+		check(visit ? "PI and PS once the cached station is received" : "PI and PS once the station is received", radio.rdsChanges() == (RDS_CHANGED_PI | RDS_CHANGED_PS));
+		for(byte i=0; i<20; i++){
+			delay(50);
+			radio.readRDS();
+		}
+		check("nothing while the station sends the same", radio.rdsChanges() == 0);
+	}
+	radio.end();
+}
+
+int main(){
+	benchmarkBoot();
+	benchmarkBus();
+	benchmarkAsync();
+	benchmarkInterrupts();
+	benchmarkRDSReads();
+	benchmarkScan(FM, "FM", 6400, 10800, 10);
+	benchmarkScan(SW, "SW", 5900, 6200, 1);
+	benchmarkStations(8750, 10790, 10);
+	benchmarkPresets();
+	benchmarkFollowing();
+	benchmarkDates();
+	benchmarkDecoder();
+	benchmarkGroups();
+	benchmarkCache();
+	benchmarkChanges();
+	benchmarkNoise();
+	benchmarkCapture();
+	return failures ? 1 : 0;
+}